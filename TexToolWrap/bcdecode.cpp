@@ -0,0 +1,1051 @@
+#include "bcdecode.h"
+#include "simd.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+// byte offsets of r, g, b and a inside one output pixel
+struct ChannelOrder {
+	uint8_t r, g, b, a;
+};
+
+typedef void (*BlockDecodeFunc)(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order);
+typedef void (*ExpandColorRowsFunc)(const uint8_t* palette, const uint8_t* indices, uint8_t* dst, ptrdiff_t dstStride);
+
+static bool GetChannelOrder(int dstMode, ChannelOrder& order) {
+	switch (dstMode) {
+		case 4:  order = { 0, 1, 2, 3 }; return true; //RGBA32
+		case 14: order = { 2, 1, 0, 3 }; return true; //BGRA32
+		case 5:  order = { 1, 2, 3, 0 }; return true; //ARGB32
+		default: return false;
+	}
+}
+
+static inline void WritePixel(uint8_t* out, const ChannelOrder& order, int r, int g, int b, int a) {
+	out[order.r] = (uint8_t)r;
+	out[order.g] = (uint8_t)g;
+	out[order.b] = (uint8_t)b;
+	out[order.a] = (uint8_t)a;
+}
+
+// little helper for the bptc formats, which are just one 128 bit stream
+struct BlockBits {
+	uint64_t lo;
+	uint64_t hi;
+	int pos;
+
+	BlockBits(const uint8_t* block) : lo(0), hi(0), pos(0) {
+		for (int i = 0; i < 8; i++) {
+			lo |= (uint64_t)block[i] << (i * 8);
+			hi |= (uint64_t)block[8 + i] << (i * 8);
+		}
+	}
+
+	// count is at most 16
+	int Read(int count) {
+		uint64_t v;
+		if (pos >= 64) {
+			v = hi >> (pos - 64);
+		} else if (pos + count <= 64) {
+			v = lo >> pos;
+		} else {
+			v = (lo >> pos) | (hi << (64 - pos));
+		}
+		pos += count;
+		return (int)(v & ((1u << count) - 1));
+	}
+};
+
+////////// dxt1 / dxt5 //////////
+
+static inline void Expand565(uint16_t c, uint8_t* out) {
+	int r = (c >> 11) & 0x1f;
+	int g = (c >> 5) & 0x3f;
+	int b = c & 0x1f;
+	out[0] = (uint8_t)((r << 3) | (r >> 2));
+	out[1] = (uint8_t)((g << 2) | (g >> 4));
+	out[2] = (uint8_t)((b << 3) | (b >> 2));
+	out[3] = 255;
+}
+
+// 4 colors back to back in the output order, which is also what the shuffles pick from
+static void BuildColorPalette(const uint8_t* block, bool allowTransparent, const ChannelOrder& order, uint8_t* palette) {
+	uint8_t rgba[16];
+	uint16_t c0 = (uint16_t)(block[0] | (block[1] << 8));
+	uint16_t c1 = (uint16_t)(block[2] | (block[3] << 8));
+	Expand565(c0, rgba + 0);
+	Expand565(c1, rgba + 4);
+
+	if (c0 > c1 || !allowTransparent) {
+		for (int c = 0; c < 3; c++) {
+			rgba[8 + c] = (uint8_t)((2 * rgba[c] + rgba[4 + c] + 1) / 3);
+			rgba[12 + c] = (uint8_t)((rgba[c] + 2 * rgba[4 + c] + 1) / 3);
+		}
+		rgba[11] = 255;
+		rgba[15] = 255;
+	} else {
+		for (int c = 0; c < 3; c++) {
+			rgba[8 + c] = (uint8_t)((rgba[c] + rgba[4 + c] + 1) / 2);
+			rgba[12 + c] = 0;
+		}
+		rgba[11] = 255;
+		rgba[15] = 0;
+	}
+
+	for (int i = 0; i < 4; i++) {
+		WritePixel(palette + i * 4, order, rgba[i * 4 + 0], rgba[i * 4 + 1], rgba[i * 4 + 2], rgba[i * 4 + 3]);
+	}
+}
+
+static void ExpandColorRowsScalar(const uint8_t* palette, const uint8_t* indices, uint8_t* dst, ptrdiff_t dstStride) {
+	for (int y = 0; y < 4; y++) {
+		uint8_t* row = dst + y * dstStride;
+		for (int x = 0; x < 4; x++) {
+			memcpy(row + x * 4, palette + ((indices[y] >> (x * 2)) & 3) * 4, 4);
+		}
+	}
+}
+
+#ifdef SIMD_X86
+// one index byte is one row of 4 pixels, so each byte value gets its own
+// pshufb mask that pulls the right palette entries into place
+struct ColorShuffleTable {
+	alignas(16) uint8_t masks[256][16];
+
+	ColorShuffleTable() {
+		for (int i = 0; i < 256; i++) {
+			for (int x = 0; x < 4; x++) {
+				int idx = (i >> (x * 2)) & 3;
+				for (int c = 0; c < 4; c++) {
+					masks[i][x * 4 + c] = (uint8_t)(idx * 4 + c);
+				}
+			}
+		}
+	}
+};
+
+static const ColorShuffleTable colorShuffleTable;
+
+TARGET_SSSE3 static void ExpandColorRowsSSSE3(const uint8_t* palette, const uint8_t* indices, uint8_t* dst, ptrdiff_t dstStride) {
+	__m128i pal = _mm_loadu_si128((const __m128i*)palette);
+	for (int y = 0; y < 4; y++) {
+		__m128i mask = _mm_load_si128((const __m128i*)colorShuffleTable.masks[indices[y]]);
+		_mm_storeu_si128((__m128i*)(dst + y * dstStride), _mm_shuffle_epi8(pal, mask));
+	}
+}
+#endif
+
+static ExpandColorRowsFunc GetExpandColorRows() {
+#ifdef SIMD_X86
+	static const ExpandColorRowsFunc func = CpuHasSSSE3() ? ExpandColorRowsSSSE3 : ExpandColorRowsScalar;
+	return func;
+#else
+	return ExpandColorRowsScalar;
+#endif
+}
+
+// bc4 style 8 value ramp with 3 bit indices. used for dxt5 alpha and
+// bc4/bc5, writes to byte `channel` of each 4 byte pixel.
+static void DecodeChannelBlock(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, int channel) {
+	uint8_t palette[8];
+	int a0 = block[0];
+	int a1 = block[1];
+	palette[0] = (uint8_t)a0;
+	palette[1] = (uint8_t)a1;
+	if (a0 > a1) {
+		for (int i = 1; i < 7; i++) {
+			palette[1 + i] = (uint8_t)(((7 - i) * a0 + i * a1 + 3) / 7);
+		}
+	} else {
+		for (int i = 1; i < 5; i++) {
+			palette[1 + i] = (uint8_t)(((5 - i) * a0 + i * a1 + 2) / 5);
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 6; i++) {
+		bits |= (uint64_t)block[2 + i] << (i * 8);
+	}
+
+	for (int i = 0; i < 16; i++) {
+		dst[(i >> 2) * dstStride + (i & 3) * 4 + channel] = palette[(bits >> (i * 3)) & 7];
+	}
+}
+
+static void DecodeDXT1Block(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	alignas(16) uint8_t palette[16];
+	BuildColorPalette(block, true, order, palette);
+	GetExpandColorRows()(palette, block + 4, dst, dstStride);
+}
+
+static void DecodeDXT5Block(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	alignas(16) uint8_t palette[16];
+	// the color half of dxt5 is always in 4 color mode
+	BuildColorPalette(block + 8, false, order, palette);
+	GetExpandColorRows()(palette, block + 12, dst, dstStride);
+	DecodeChannelBlock(block, dst, dstStride, order.a);
+}
+
+static void DecodeBC4Block(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	for (int i = 0; i < 16; i++) {
+		WritePixel(dst + (i >> 2) * dstStride + (i & 3) * 4, order, 0, 0, 0, 255);
+	}
+	DecodeChannelBlock(block, dst, dstStride, order.r);
+}
+
+static void DecodeBC5Block(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	for (int i = 0; i < 16; i++) {
+		WritePixel(dst + (i >> 2) * dstStride + (i & 3) * 4, order, 0, 0, 0, 255);
+	}
+	DecodeChannelBlock(block, dst, dstStride, order.r);
+	DecodeChannelBlock(block + 8, dst, dstStride, order.g);
+}
+
+////////// bptc tables (shared by bc6h and bc7) //////////
+
+// bit i set means pixel i is in subset 1
+static const uint16_t partitions2[64] = {
+	0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+	0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+	0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+	0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+	0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+	0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+	0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+	0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22,
+};
+
+// 2 bits per pixel, pixel 0 in the low bits
+static const uint32_t partitions3[64] = {
+	0xaa685050, 0x6a5a5040, 0x5a5a4200, 0x5450a0a8, 0xa5a50000, 0xa0a05050, 0x5555a0a0, 0x5a5a5050,
+	0xaa550000, 0xaa555500, 0xaaaa5500, 0x90909090, 0x94949494, 0xa4a4a4a4, 0xa9a59450, 0x2a0a4250,
+	0xa5945040, 0x0a425054, 0xa5a5a500, 0x55a0a0a0, 0xa8a85454, 0x6a6a4040, 0xa4a45000, 0x1a1a0500,
+	0x0050a4a4, 0xaaa59090, 0x14696914, 0x69691400, 0xa08585a0, 0xaa821414, 0x50a4a450, 0x6a5a0200,
+	0xa9a58000, 0x5090a0a8, 0xa8a09050, 0x24242424, 0x00aa5500, 0x24924924, 0x24499224, 0x50a50a50,
+	0x500aa550, 0xaaaa4444, 0x66660000, 0xa5a0a5a0, 0x50a050a0, 0x69286928, 0x44aaaa44, 0x66666600,
+	0xaa444444, 0x54a854a8, 0x95809580, 0x96969600, 0xa85454a8, 0x80959580, 0xaa141414, 0x96960000,
+	0xaaaa1414, 0xa05050a0, 0xa0a5a5a0, 0x96000000, 0x40804080, 0xa9a8a9a8, 0xaaaaaa44, 0x2a4a5254,
+};
+
+static const uint8_t anchors2[64] = {
+	15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+	15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+	15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+	 6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15,
+};
+
+static const uint8_t anchors3Second[64] = {
+	 3,  3, 15, 15,  8,  3, 15, 15,  8,  8,  6,  6,  6,  5,  3,  3,
+	 3,  3,  8, 15,  3,  3,  6, 10,  5,  8,  8,  6,  8,  5, 15, 15,
+	 8, 15,  3,  5,  6, 10,  8, 15, 15,  3, 15,  5, 15, 15, 15, 15,
+	 3, 15,  5,  5,  5,  8,  5, 10,  5, 10,  8, 13, 15, 12,  3,  3,
+};
+
+static const uint8_t anchors3Third[64] = {
+	15,  8,  8,  3, 15, 15,  3,  8, 15, 15, 15, 15, 15, 15, 15,  8,
+	15,  8, 15,  3, 15,  8, 15,  8,  3, 15,  6, 10, 15, 15, 10,  8,
+	15,  3, 15, 10, 10,  8,  9, 10,  6, 15,  8, 15,  3,  6,  6,  8,
+	15,  3, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,  3, 15, 15,  8,
+};
+
+static const uint8_t bc6hLayouts[14][75] = {
+	{
+		0x74, 0x84, 0xb4, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12,
+		0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+		0x29, 0x30, 0x31, 0x32, 0x33, 0x34, 0xa4, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44,
+		0xb0, 0xa0, 0xa1, 0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0xb1, 0x80, 0x81, 0x82, 0x83, 0x60,
+		0x61, 0x62, 0x63, 0x64, 0xb2, 0x90, 0x91, 0x92, 0x93, 0x94, 0xb3,
+	},
+	{
+		0x75, 0xa4, 0xa5, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0xb0, 0xb1, 0x84, 0x10, 0x11, 0x12,
+		0x13, 0x14, 0x15, 0x16, 0x85, 0xb2, 0x74, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0xb3, 0xb5,
+		0xb4, 0x30, 0x31, 0x32, 0x33, 0x34, 0x35, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44,
+		0x45, 0xa0, 0xa1, 0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x80, 0x81, 0x82, 0x83, 0x60,
+		0x61, 0x62, 0x63, 0x64, 0x65, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0x0a, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x1a, 0xb0, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x2a, 0xb1, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0x64, 0xb2, 0x90, 0x91, 0x92, 0x93, 0x94, 0xb3,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x0a, 0xa4, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44, 0x1a, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x2a, 0xb1, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0xb0, 0xb2, 0x90, 0x91, 0x92, 0x93, 0x74, 0xb3,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x0a, 0x84, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x1a, 0xb0, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0x2a, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0xb1, 0xb2, 0x90, 0x91, 0x92, 0x93, 0xb4, 0xb3,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x84, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x74, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0xb4, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0xa4, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44, 0xb0, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0xb1, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0x64, 0xb2, 0x90, 0x91, 0x92, 0x93, 0x94, 0xb3,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xa4, 0x84, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0xb2, 0x74, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0xb3, 0xb4, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0x35, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44, 0xb0, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0xb1, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0x64, 0x65, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xb0, 0x84, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x75, 0x74, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0xa5, 0xb4, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0xa4, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0xb1, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0x64, 0xb2, 0x90, 0x91, 0x92, 0x93, 0x94, 0xb3,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0xb1, 0x84, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x85, 0x74, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0xb5, 0xb4, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0xa4, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44, 0xb0, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0x64, 0xb2, 0x90, 0x91, 0x92, 0x93, 0x94, 0xb3,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0xa4, 0xb0, 0xb1, 0x84, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x75, 0x85, 0xb2, 0x74, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0xa5, 0xb3, 0xb5, 0xb4, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0x35, 0x70, 0x71, 0x72, 0x73, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0xa0, 0xa1,
+		0xa2, 0xa3, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x80, 0x81, 0x82, 0x83, 0x60, 0x61, 0x62, 0x63,
+		0x64, 0x65, 0x90, 0x91, 0x92, 0x93, 0x94, 0x95,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+		0x48, 0x49, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x0a, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+		0x48, 0x1a, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x2a,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x0b, 0x0a, 0x40, 0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47,
+		0x1b, 0x1a, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x2b, 0x2a,
+	},
+	{
+		0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15,
+		0x16, 0x17, 0x18, 0x19, 0x20, 0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x30, 0x31,
+		0x32, 0x33, 0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x40, 0x41, 0x42, 0x43, 0x1f, 0x1e, 0x1d, 0x1c,
+		0x1b, 0x1a, 0x50, 0x51, 0x52, 0x53, 0x2f, 0x2e, 0x2d, 0x2c, 0x2b, 0x2a,
+	},
+};
+static const uint8_t weights2[4] = { 0, 21, 43, 64 };
+static const uint8_t weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const uint8_t weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const uint8_t* GetWeights(int indexBits) {
+	switch (indexBits) {
+		case 2: return weights2;
+		case 3: return weights3;
+		default: return weights4;
+	}
+}
+
+static inline int Interpolate(int e0, int e1, int weight) {
+	return (e0 * (64 - weight) + e1 * weight + 32) >> 6;
+}
+
+// bc7 interpolation on a whole block at once. e0, e1 and weights hold one
+// byte per output byte (64 of them, already in the output pixel layout), so
+// every byte is the same math and the simd versions don't shuffle anything.
+typedef void (*InterpolateBytesFunc)(const uint8_t* e0, const uint8_t* e1, const uint8_t* weights, uint8_t* dst, ptrdiff_t dstStride);
+
+static void InterpolateBytesScalar(const uint8_t* e0, const uint8_t* e1, const uint8_t* weights, uint8_t* dst, ptrdiff_t dstStride) {
+	for (int y = 0; y < 4; y++) {
+		uint8_t* row = dst + y * dstStride;
+		for (int x = 0; x < 16; x++) {
+			int i = y * 16 + x;
+			row[x] = (uint8_t)Interpolate(e0[i], e1[i], weights[i]);
+		}
+	}
+}
+
+#ifdef SIMD_X86
+// endpoints are at most 255 and weights at most 64, so 16 bit lanes never overflow
+TARGET_SSE41 static inline __m128i InterpolateEpi16SSE41(__m128i e0, __m128i e1, __m128i w) {
+	__m128i sum = _mm_add_epi16(_mm_mullo_epi16(e0, _mm_sub_epi16(_mm_set1_epi16(64), w)), _mm_mullo_epi16(e1, w));
+	return _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(32)), 6);
+}
+
+TARGET_SSE41 static void InterpolateBytesSSE41(const uint8_t* e0, const uint8_t* e1, const uint8_t* weights, uint8_t* dst, ptrdiff_t dstStride) {
+	for (int y = 0; y < 4; y++) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(e0 + y * 16));
+		__m128i b = _mm_loadu_si128((const __m128i*)(e1 + y * 16));
+		__m128i w = _mm_loadu_si128((const __m128i*)(weights + y * 16));
+		__m128i lo = InterpolateEpi16SSE41(_mm_cvtepu8_epi16(a), _mm_cvtepu8_epi16(b), _mm_cvtepu8_epi16(w));
+		__m128i hi = InterpolateEpi16SSE41(_mm_cvtepu8_epi16(_mm_srli_si128(a, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(b, 8)), _mm_cvtepu8_epi16(_mm_srli_si128(w, 8)));
+		_mm_storeu_si128((__m128i*)(dst + y * dstStride), _mm_packus_epi16(lo, hi));
+	}
+}
+
+TARGET_AVX2 static inline __m256i InterpolateRowAVX2(const uint8_t* e0, const uint8_t* e1, const uint8_t* weights) {
+	__m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)e0));
+	__m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)e1));
+	__m256i w = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)weights));
+	__m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, _mm256_sub_epi16(_mm256_set1_epi16(64), w)), _mm256_mullo_epi16(b, w));
+	return _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_set1_epi16(32)), 6);
+}
+
+// two rows per step. the pack works per 128 bit lane, so the permute puts
+// the first row back in the low half and the second in the high half
+TARGET_AVX2 static void InterpolateBytesAVX2(const uint8_t* e0, const uint8_t* e1, const uint8_t* weights, uint8_t* dst, ptrdiff_t dstStride) {
+	for (int y = 0; y < 4; y += 2) {
+		__m256i row0 = InterpolateRowAVX2(e0 + y * 16, e1 + y * 16, weights + y * 16);
+		__m256i row1 = InterpolateRowAVX2(e0 + y * 16 + 16, e1 + y * 16 + 16, weights + y * 16 + 16);
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(row0, row1), 0xd8);
+		_mm_storeu_si128((__m128i*)(dst + y * dstStride), _mm256_castsi256_si128(packed));
+		_mm_storeu_si128((__m128i*)(dst + (y + 1) * dstStride), _mm256_extracti128_si256(packed, 1));
+	}
+}
+#endif
+
+static InterpolateBytesFunc GetInterpolateBytes() {
+#ifdef SIMD_X86
+	static const InterpolateBytesFunc func =
+		CpuHasAVX2() ? InterpolateBytesAVX2 :
+		CpuHasSSE41() ? InterpolateBytesSSE41 :
+		InterpolateBytesScalar;
+	return func;
+#else
+	return InterpolateBytesScalar;
+#endif
+}
+
+////////// bc7 //////////
+
+struct BC7ModeInfo {
+	uint8_t subsets;
+	uint8_t partitionBits;
+	uint8_t rotationBits;
+	uint8_t indexSelectionBits;
+	uint8_t colorBits;
+	uint8_t alphaBits;
+	uint8_t endpointPBits;
+	uint8_t sharedPBits;
+	uint8_t indexBits;
+	uint8_t indexBits2;
+};
+
+static const BC7ModeInfo bc7Modes[8] = {
+	{ 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 },
+	{ 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+	{ 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 },
+	{ 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+	{ 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 },
+	{ 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+	{ 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 },
+	{ 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+};
+
+static inline int ExpandBits(int v, int bits) {
+	v <<= 8 - bits;
+	return v | (v >> bits);
+}
+
+static inline int GetSubset(int subsets, int partition, int pixel) {
+	switch (subsets) {
+		case 2: return (partitions2[partition] >> pixel) & 1;
+		case 3: return (partitions3[partition] >> (pixel * 2)) & 3;
+		default: return 0;
+	}
+}
+
+static void DecodeBC7Block(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	int mode = 0;
+	while (mode < 8 && !(block[0] & (1 << mode))) {
+		mode++;
+	}
+
+	if (mode == 8) {
+		// reserved, comes out as transparent black
+		for (int i = 0; i < 16; i++) {
+			WritePixel(dst + (i >> 2) * dstStride + (i & 3) * 4, order, 0, 0, 0, 0);
+		}
+		return;
+	}
+
+	const BC7ModeInfo& info = bc7Modes[mode];
+	BlockBits bits(block);
+	bits.Read(mode + 1);
+
+	int partition = bits.Read(info.partitionBits);
+	int rotation = bits.Read(info.rotationBits);
+	int indexSelection = bits.Read(info.indexSelectionBits);
+
+	int endpointCount = info.subsets * 2;
+	int endpoints[6][4];
+	for (int c = 0; c < 3; c++) {
+		for (int e = 0; e < endpointCount; e++) {
+			endpoints[e][c] = bits.Read(info.colorBits);
+		}
+	}
+	for (int e = 0; e < endpointCount; e++) {
+		endpoints[e][3] = bits.Read(info.alphaBits);
+	}
+
+	int colorBits = info.colorBits;
+	int alphaBits = info.alphaBits;
+	if (info.endpointPBits || info.sharedPBits) {
+		int pBits[6];
+		if (info.endpointPBits) {
+			for (int e = 0; e < endpointCount; e++) {
+				pBits[e] = bits.Read(1);
+			}
+		} else {
+			for (int s = 0; s < info.subsets; s++) {
+				pBits[s * 2] = pBits[s * 2 + 1] = bits.Read(1);
+			}
+		}
+
+		int channels = alphaBits ? 4 : 3;
+		for (int e = 0; e < endpointCount; e++) {
+			for (int c = 0; c < channels; c++) {
+				endpoints[e][c] = (endpoints[e][c] << 1) | pBits[e];
+			}
+		}
+		colorBits++;
+		if (alphaBits) {
+			alphaBits++;
+		}
+	}
+
+	for (int e = 0; e < endpointCount; e++) {
+		for (int c = 0; c < 3; c++) {
+			endpoints[e][c] = ExpandBits(endpoints[e][c], colorBits);
+		}
+		endpoints[e][3] = alphaBits ? ExpandBits(endpoints[e][3], alphaBits) : 255;
+	}
+
+	int anchors[3] = { 0, 0, 0 };
+	if (info.subsets == 2) {
+		anchors[1] = anchors2[partition];
+	} else if (info.subsets == 3) {
+		anchors[1] = anchors3Second[partition];
+		anchors[2] = anchors3Third[partition];
+	}
+
+	uint8_t subsets[16];
+	uint8_t indices[16];
+	for (int i = 0; i < 16; i++) {
+		subsets[i] = (uint8_t)GetSubset(info.subsets, partition, i);
+		// anchor indices drop their top bit
+		indices[i] = (uint8_t)bits.Read(info.indexBits - (i == anchors[subsets[i]] ? 1 : 0));
+	}
+
+	uint8_t indices2[16];
+	if (info.indexBits2) {
+		for (int i = 0; i < 16; i++) {
+			indices2[i] = (uint8_t)bits.Read(info.indexBits2 - (i == 0 ? 1 : 0));
+		}
+	}
+
+	const uint8_t* colorIndices = indices;
+	const uint8_t* alphaIndices = indices;
+	const uint8_t* colorWeights = GetWeights(info.indexBits);
+	const uint8_t* alphaWeights = colorWeights;
+	if (info.indexBits2) {
+		if (indexSelection) {
+			colorIndices = indices2;
+			colorWeights = GetWeights(info.indexBits2);
+		} else {
+			alphaIndices = indices2;
+			alphaWeights = GetWeights(info.indexBits2);
+		}
+	}
+
+	// rotation swaps alpha with one of the colors after interpolating, which
+	// is the same as swapping which endpoint channel feeds each output byte.
+	// each endpoint becomes one pixel word in the output layout up front.
+	int srcChannels[4] = { 0, 1, 2, 3 };
+	if (rotation) {
+		std::swap(srcChannels[rotation - 1], srcChannels[3]);
+	}
+	const uint8_t dstOffsets[4] = { order.r, order.g, order.b, order.a };
+
+	uint32_t endpointWords[6];
+	uint32_t alphaLaneMask = 0;
+	for (int e = 0; e < endpointCount; e++) {
+		endpointWords[e] = 0;
+		for (int c = 0; c < 4; c++) {
+			endpointWords[e] |= (uint32_t)endpoints[e][srcChannels[c]] << (dstOffsets[c] * 8);
+		}
+	}
+	for (int c = 0; c < 4; c++) {
+		if (srcChannels[c] == 3) {
+			alphaLaneMask = 0xffu << (dstOffsets[c] * 8);
+		}
+	}
+
+	alignas(16) uint32_t laneE0[16];
+	alignas(16) uint32_t laneE1[16];
+	alignas(16) uint32_t laneWeights[16];
+	for (int i = 0; i < 16; i++) {
+		uint32_t colorWeight = colorWeights[colorIndices[i]] * 0x01010101u;
+		uint32_t alphaWeight = alphaWeights[alphaIndices[i]] * 0x01010101u;
+		laneE0[i] = endpointWords[subsets[i] * 2];
+		laneE1[i] = endpointWords[subsets[i] * 2 + 1];
+		laneWeights[i] = (colorWeight & ~alphaLaneMask) | (alphaWeight & alphaLaneMask);
+	}
+
+	GetInterpolateBytes()((const uint8_t*)laneE0, (const uint8_t*)laneE1, (const uint8_t*)laneWeights, dst, dstStride);
+}
+
+////////// bc6h (unsigned only, which is what unity uses) //////////
+
+struct BC6HModeInfo {
+	uint8_t modeValue;
+	uint8_t regions;
+	bool transformed;
+	uint8_t endpointBits;
+	uint8_t deltaBits[3];
+	uint8_t layoutBits;
+};
+
+static const BC6HModeInfo bc6hModes[14] = {
+	{ 0x00, 2, true,  10, { 5, 5, 5 }, 75 },
+	{ 0x01, 2, true,   7, { 6, 6, 6 }, 75 },
+	{ 0x02, 2, true,  11, { 5, 4, 4 }, 72 },
+	{ 0x06, 2, true,  11, { 4, 5, 4 }, 72 },
+	{ 0x0a, 2, true,  11, { 4, 4, 5 }, 72 },
+	{ 0x0e, 2, true,   9, { 5, 5, 5 }, 72 },
+	{ 0x12, 2, true,   8, { 6, 5, 5 }, 72 },
+	{ 0x16, 2, true,   8, { 5, 6, 5 }, 72 },
+	{ 0x1a, 2, true,   8, { 5, 5, 6 }, 72 },
+	{ 0x1e, 2, false,  6, { 6, 6, 6 }, 72 },
+	{ 0x03, 1, false, 10, { 10, 10, 10 }, 60 },
+	{ 0x07, 1, true,  11, { 9, 9, 9 }, 60 },
+	{ 0x0b, 1, true,  12, { 8, 8, 8 }, 60 },
+	{ 0x0f, 1, true,  16, { 4, 4, 4 }, 60 },
+};
+
+static inline int SignExtend(int v, int bits) {
+	int sign = 1 << (bits - 1);
+	return ((v & ((1 << bits) - 1)) ^ sign) - sign;
+}
+
+static inline int UnquantizeBC6H(int v, int bits) {
+	if (bits >= 15) {
+		return v;
+	} else if (v == 0) {
+		return 0;
+	} else if (v == (1 << bits) - 1) {
+		return 0xffff;
+	} else {
+		return ((v << 16) + 0x8000) >> bits;
+	}
+}
+
+// bc6h works on 4 lanes per pixel (r, g, b and an unused one that stays 0).
+// the endpoints are 16 bit, so the interpolation needs 32 bit lanes.
+typedef void (*InterpolateBC6HFunc)(const int32_t* e0, const int32_t* e1, const int32_t* weights, uint16_t* out);
+typedef void (*HalvesToUnorm8Func)(const uint16_t* halves, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order);
+
+static void InterpolateBC6HScalar(const int32_t* e0, const int32_t* e1, const int32_t* weights, uint16_t* out) {
+	for (int i = 0; i < 64; i++) {
+		out[i] = (uint16_t)((Interpolate(e0[i], e1[i], weights[i]) * 31) >> 6);
+	}
+}
+
+static void HalvesToUnorm8Scalar(const uint16_t* halves, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order);
+
+#ifdef SIMD_X86
+// one pixel per step, packed in pairs. unsigned bc6h tops out at 0x7bff so
+// the unsigned pack never saturates
+TARGET_SSE41 static void InterpolateBC6HSSE41(const int32_t* e0, const int32_t* e1, const int32_t* weights, uint16_t* out) {
+	for (int i = 0; i < 64; i += 8) {
+		__m128i px[2];
+		for (int p = 0; p < 2; p++) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(e0 + i + p * 4));
+			__m128i b = _mm_loadu_si128((const __m128i*)(e1 + i + p * 4));
+			__m128i w = _mm_loadu_si128((const __m128i*)(weights + i + p * 4));
+			__m128i sum = _mm_add_epi32(_mm_mullo_epi32(a, _mm_sub_epi32(_mm_set1_epi32(64), w)), _mm_mullo_epi32(b, w));
+			__m128i v = _mm_srli_epi32(_mm_add_epi32(sum, _mm_set1_epi32(32)), 6);
+			px[p] = _mm_srli_epi32(_mm_mullo_epi32(v, _mm_set1_epi32(31)), 6);
+		}
+		_mm_storeu_si128((__m128i*)(out + i), _mm_packus_epi32(px[0], px[1]));
+	}
+}
+
+TARGET_AVX2 static void InterpolateBC6HAVX2(const int32_t* e0, const int32_t* e1, const int32_t* weights, uint16_t* out) {
+	for (int i = 0; i < 64; i += 16) {
+		__m256i px[2];
+		for (int p = 0; p < 2; p++) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)(e0 + i + p * 8));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(e1 + i + p * 8));
+			__m256i w = _mm256_loadu_si256((const __m256i*)(weights + i + p * 8));
+			__m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(a, _mm256_sub_epi32(_mm256_set1_epi32(64), w)), _mm256_mullo_epi32(b, w));
+			__m256i v = _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(32)), 6);
+			px[p] = _mm256_srli_epi32(_mm256_mullo_epi32(v, _mm256_set1_epi32(31)), 6);
+		}
+		__m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(px[0], px[1]), 0xd8);
+		_mm256_storeu_si256((__m256i*)(out + i), packed);
+	}
+}
+
+// pshufb mask moving each pixel's r, g, b, a bytes to their order offsets
+TARGET_SSE41 static inline __m128i GetOrderShuffle(const ChannelOrder& order) {
+	uint8_t inverse[4];
+	inverse[order.r] = 0;
+	inverse[order.g] = 1;
+	inverse[order.b] = 2;
+	inverse[order.a] = 3;
+	int pattern = inverse[0] | (inverse[1] << 8) | (inverse[2] << 16) | (inverse[3] << 24);
+	return _mm_add_epi8(_mm_set1_epi32(pattern), _mm_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12));
+}
+
+// the halves here are never negative, inf or nan, so shifting them into a
+// float's bits and scaling by 2^112 converts them exactly, denormals too.
+// the rest is the same clamp and round as HalfToUnorm8.
+TARGET_SSE41 static inline __m128i HalfLanesToUnorm8SSE41(__m128i h) {
+	__m128 f = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(h, 13)), _mm_castsi128_ps(_mm_set1_epi32(0x77800000))); //2^112
+	f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+}
+
+TARGET_SSE41 static void HalvesToUnorm8SSE41(const uint16_t* halves, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	const __m128i shuffle = GetOrderShuffle(order);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	for (int y = 0; y < 4; y++) {
+		__m128i h01 = _mm_loadu_si128((const __m128i*)(halves + y * 16));
+		__m128i h23 = _mm_loadu_si128((const __m128i*)(halves + y * 16 + 8));
+		__m128i p0 = HalfLanesToUnorm8SSE41(_mm_cvtepu16_epi32(h01));
+		__m128i p1 = HalfLanesToUnorm8SSE41(_mm_cvtepu16_epi32(_mm_srli_si128(h01, 8)));
+		__m128i p2 = HalfLanesToUnorm8SSE41(_mm_cvtepu16_epi32(h23));
+		__m128i p3 = HalfLanesToUnorm8SSE41(_mm_cvtepu16_epi32(_mm_srli_si128(h23, 8)));
+		__m128i row = _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+		row = _mm_shuffle_epi8(_mm_or_si128(row, alpha), shuffle);
+		_mm_storeu_si128((__m128i*)(dst + y * dstStride), row);
+	}
+}
+
+TARGET_AVX2 static inline __m256i HalfLanesToUnorm8AVX2(__m256i h) {
+	__m256 f = _mm256_mul_ps(_mm256_castsi256_ps(_mm256_slli_epi32(h, 13)), _mm256_castsi256_ps(_mm256_set1_epi32(0x77800000))); //2^112
+	f = _mm256_min_ps(_mm256_max_ps(f, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(f, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+}
+
+TARGET_AVX2 static void HalvesToUnorm8AVX2(const uint16_t* halves, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	const __m128i shuffle = GetOrderShuffle(order);
+	const __m128i alpha = _mm_set1_epi32((int)0xff000000);
+	for (int y = 0; y < 4; y++) {
+		__m256i p01 = HalfLanesToUnorm8AVX2(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(halves + y * 16))));
+		__m256i p23 = HalfLanesToUnorm8AVX2(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(halves + y * 16 + 8))));
+		__m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(p01, p23), 0xd8);
+		__m128i row = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+		row = _mm_shuffle_epi8(_mm_or_si128(row, alpha), shuffle);
+		_mm_storeu_si128((__m128i*)(dst + y * dstStride), row);
+	}
+}
+#endif
+
+static InterpolateBC6HFunc GetInterpolateBC6H() {
+#ifdef SIMD_X86
+	static const InterpolateBC6HFunc func =
+		CpuHasAVX2() ? InterpolateBC6HAVX2 :
+		CpuHasSSE41() ? InterpolateBC6HSSE41 :
+		InterpolateBC6HScalar;
+	return func;
+#else
+	return InterpolateBC6HScalar;
+#endif
+}
+
+static HalvesToUnorm8Func GetHalvesToUnorm8() {
+#ifdef SIMD_X86
+	static const HalvesToUnorm8Func func =
+		CpuHasAVX2() ? HalvesToUnorm8AVX2 :
+		CpuHasSSE41() ? HalvesToUnorm8SSE41 :
+		HalvesToUnorm8Scalar;
+	return func;
+#else
+	return HalvesToUnorm8Scalar;
+#endif
+}
+
+// decodes to 16 half float pixels of 4 lanes, the 4th one is left at 0
+static void DecodeBC6HBlock(const uint8_t* block, uint16_t* out) {
+	BlockBits bits(block);
+	int modeValue = bits.Read(2);
+	if (modeValue >= 2) {
+		modeValue |= bits.Read(3) << 2;
+	}
+
+	int mode = 0;
+	while (mode < 14 && bc6hModes[mode].modeValue != modeValue) {
+		mode++;
+	}
+
+	if (mode == 14) {
+		// reserved
+		memset(out, 0, sizeof(uint16_t) * 16 * 4);
+		return;
+	}
+
+	const BC6HModeInfo& info = bc6hModes[mode];
+
+	// the endpoint bits are scattered all over the place, so the layout
+	// table lists which endpoint (w/x/y/z), channel and bit each one is
+	int endpoints[4][3] = {};
+	for (int i = 0; i < info.layoutBits; i++) {
+		int field = bc6hLayouts[mode][i] >> 4;
+		int bit = bc6hLayouts[mode][i] & 15;
+		endpoints[field / 3][field % 3] |= bits.Read(1) << bit;
+	}
+
+	int partition = info.regions == 2 ? bits.Read(5) : 0;
+	int endpointCount = info.regions * 2;
+	int endpointMask = (1 << info.endpointBits) - 1;
+
+	for (int e = 0; e < endpointCount; e++) {
+		for (int c = 0; c < 3; c++) {
+			if (info.transformed && e > 0) {
+				endpoints[e][c] = (endpoints[0][c] + SignExtend(endpoints[e][c], info.deltaBits[c])) & endpointMask;
+			}
+		}
+	}
+	for (int e = 0; e < endpointCount; e++) {
+		for (int c = 0; c < 3; c++) {
+			endpoints[e][c] = UnquantizeBC6H(endpoints[e][c], info.endpointBits);
+		}
+	}
+
+	int indexBits = info.regions == 2 ? 3 : 4;
+	int anchor = info.regions == 2 ? anchors2[partition] : 0;
+	const uint8_t* weights = GetWeights(indexBits);
+
+	alignas(32) int32_t laneE0[64];
+	alignas(32) int32_t laneE1[64];
+	alignas(32) int32_t laneWeights[64];
+	for (int i = 0; i < 16; i++) {
+		int subset = info.regions == 2 ? (partitions2[partition] >> i) & 1 : 0;
+		int index = bits.Read(indexBits - ((i == 0 || i == anchor) ? 1 : 0));
+		const int* e0 = endpoints[subset * 2];
+		const int* e1 = endpoints[subset * 2 + 1];
+		for (int c = 0; c < 3; c++) {
+			laneE0[i * 4 + c] = e0[c];
+			laneE1[i * 4 + c] = e1[c];
+			laneWeights[i * 4 + c] = weights[index];
+		}
+		laneE0[i * 4 + 3] = 0;
+		laneE1[i * 4 + 3] = 0;
+		laneWeights[i * 4 + 3] = 0;
+	}
+
+	GetInterpolateBC6H()(laneE0, laneE1, laneWeights, out);
+}
+
+static float HalfToFloat(uint16_t h) {
+	int exponent = (h >> 10) & 0x1f;
+	int mantissa = h & 0x3ff;
+	float v;
+	if (exponent == 0) {
+		v = ldexpf((float)mantissa, -24);
+	} else if (exponent == 31) {
+		v = INFINITY;
+	} else {
+		v = ldexpf((float)(mantissa | 0x400), exponent - 25);
+	}
+	return (h & 0x8000) ? -v : v;
+}
+
+static inline int HalfToUnorm8(uint16_t h) {
+	float v = std::min(std::max(HalfToFloat(h), 0.0f), 1.0f);
+	return (int)(v * 255.0f + 0.5f);
+}
+
+static void HalvesToUnorm8Scalar(const uint16_t* halves, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	for (int i = 0; i < 16; i++) {
+		const uint16_t* px = halves + i * 4;
+		WritePixel(dst + (i >> 2) * dstStride + (i & 3) * 4, order,
+			HalfToUnorm8(px[0]), HalfToUnorm8(px[1]), HalfToUnorm8(px[2]), 255);
+	}
+}
+
+static void DecodeBC6HBlockUnorm8(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	alignas(16) uint16_t halves[64];
+	DecodeBC6HBlock(block, halves);
+	GetHalvesToUnorm8()(halves, dst, dstStride, order);
+}
+
+// same as the byte formats, but the offsets in order count 2 byte channels
+static void DecodeBC6HBlockHalf(const uint8_t* block, uint8_t* dst, ptrdiff_t dstStride, const ChannelOrder& order) {
+	alignas(16) uint16_t halves[64];
+	DecodeBC6HBlock(block, halves);
+	for (int i = 0; i < 16; i++) {
+		const uint16_t* src = halves + i * 4;
+		uint16_t px[4];
+		px[order.r] = src[0];
+		px[order.g] = src[1];
+		px[order.b] = src[2];
+		px[order.a] = 0x3c00; //alpha is 1.0
+		memcpy(dst + (i >> 2) * dstStride + (i & 3) * 8, px, 8);
+	}
+}
+
+////////// surfaces //////////
+
+static void DecodeBlocks(const uint8_t* src, unsigned int width, unsigned int height, uint8_t* dst, int blockByteSize, int pixelSize,
+	BlockDecodeFunc decodeBlock, const ChannelOrder& order, bool flipY) {
+	unsigned int blockCountX = (width + 3) >> 2;
+	unsigned int blockCountY = (height + 3) >> 2;
+	ptrdiff_t dstStride = (ptrdiff_t)width * pixelSize;
+
+	// flipped just means starting on the last row and walking up
+	if (flipY && height > 0) {
+		dst += (height - 1) * dstStride;
+		dstStride = -dstStride;
+	}
+
+	ParallelFor((int)blockCountY, [&](int by) {
+		const uint8_t* block = src + (size_t)by * blockCountX * blockByteSize;
+		unsigned int rows = std::min(4U, height - by * 4);
+
+		for (unsigned int bx = 0; bx < blockCountX; bx++, block += blockByteSize) {
+			uint8_t* out = dst + (ptrdiff_t)by * 4 * dstStride + (ptrdiff_t)bx * 4 * pixelSize;
+			unsigned int cols = std::min(4U, width - bx * 4);
+
+			if (rows == 4 && cols == 4) {
+				decodeBlock(block, out, dstStride, order);
+			} else {
+				// edge block, decode the whole thing and keep what fits
+				uint8_t tile[4 * 4 * 8];
+				decodeBlock(block, tile, 4 * pixelSize, order);
+				for (unsigned int y = 0; y < rows; y++) {
+					memcpy(out + (ptrdiff_t)y * dstStride, tile + y * 4 * pixelSize, cols * pixelSize);
+				}
+			}
+		}
+	});
+}
+
+// one output pixel per sampled block, the average of the texels of that block
+// that are inside the image. only every blockStep-th block in each direction
+// gets decoded, so a big texture shrinks without touching most of its blocks.
+static void DecodeBlockAverages(const uint8_t* src, unsigned int width, unsigned int height, unsigned int blockStep, uint8_t* dst,
+	int blockByteSize, BlockDecodeFunc decodeBlock, const ChannelOrder& order, bool flipY) {
+	unsigned int blockCountX = (width + 3) >> 2;
+	unsigned int outWidth, outHeight;
+	GetBCPreviewSize(width, height, blockStep, outWidth, outHeight);
+	ptrdiff_t dstStride = (ptrdiff_t)outWidth * 4;
+
+	if (flipY && outHeight > 0) {
+		dst += (outHeight - 1) * dstStride;
+		dstStride = -dstStride;
+	}
+
+	ParallelFor((int)outHeight, [&](int oy) {
+		unsigned int by = oy * blockStep;
+		unsigned int rows = std::min(4U, height - by * 4);
+		uint8_t* out = dst + (ptrdiff_t)oy * dstStride;
+
+		for (unsigned int ox = 0; ox < outWidth; ox++, out += 4) {
+			unsigned int bx = ox * blockStep;
+			unsigned int cols = std::min(4U, width - bx * 4);
+			const uint8_t* block = src + ((size_t)by * blockCountX + bx) * blockByteSize;
+
+			uint8_t tile[4 * 4 * 4];
+			decodeBlock(block, tile, 4 * 4, order);
+
+			unsigned int sums[4] = { 0, 0, 0, 0 };
+			for (unsigned int y = 0; y < rows; y++) {
+				for (unsigned int x = 0; x < cols; x++) {
+					const uint8_t* px = tile + (y * 4 + x) * 4;
+					sums[0] += px[0];
+					sums[1] += px[1];
+					sums[2] += px[2];
+					sums[3] += px[3];
+				}
+			}
+
+			unsigned int count = rows * cols;
+			for (int c = 0; c < 4; c++) {
+				out[c] = (uint8_t)((sums[c] + count / 2) / count);
+			}
+		}
+	});
+}
+
+void GetBCPreviewSize(unsigned int width, unsigned int height, unsigned int blockStep, unsigned int& outWidth, unsigned int& outHeight) {
+	blockStep = std::max(1U, blockStep);
+	outWidth = (((width + 3) >> 2) + blockStep - 1) / blockStep;
+	outHeight = (((height + 3) >> 2) + blockStep - 1) / blockStep;
+}
+
+bool DecodeBCPreview(int mode, int dstMode, const uint8_t* src, unsigned int width, unsigned int height, unsigned int blockStep, uint8_t* dst, bool flipY) {
+	ChannelOrder order;
+	if (!GetChannelOrder(dstMode, order)) {
+		return false;
+	}
+
+	blockStep = std::max(1U, blockStep);
+	switch (mode) {
+		case 10: DecodeBlockAverages(src, width, height, blockStep, dst, 8, DecodeDXT1Block, order, flipY); return true; //DXT1
+		case 12: DecodeBlockAverages(src, width, height, blockStep, dst, 16, DecodeDXT5Block, order, flipY); return true; //DXT5
+		case 26: DecodeBlockAverages(src, width, height, blockStep, dst, 8, DecodeBC4Block, order, flipY); return true; //BC4
+		case 27: DecodeBlockAverages(src, width, height, blockStep, dst, 16, DecodeBC5Block, order, flipY); return true; //BC5
+		case 24: DecodeBlockAverages(src, width, height, blockStep, dst, 16, DecodeBC6HBlockUnorm8, order, flipY); return true; //BC6H
+		case 25: DecodeBlockAverages(src, width, height, blockStep, dst, 16, DecodeBC7Block, order, flipY); return true; //BC7
+		default: return false;
+	}
+}
+
+int GetBCDecodePixelSize(int dstMode) {
+	switch (dstMode) {
+		case 4:  //RGBA32
+		case 14: //BGRA32
+		case 5:  //ARGB32
+			return 4;
+		case 17: //RGBAHalf
+			return 8;
+		default:
+			return 0;
+	}
+}
+
+bool DecodeBCSurface(int mode, int dstMode, const uint8_t* src, unsigned int width, unsigned int height, uint8_t* dst, bool flipY) {
+	if (dstMode == 17) {
+		if (mode != 24) {
+			return false;
+		}
+		ChannelOrder halfOrder = { 0, 1, 2, 3 }; //RGBAHalf
+		DecodeBlocks(src, width, height, dst, 16, 8, DecodeBC6HBlockHalf, halfOrder, flipY);
+		return true;
+	}
+
+	ChannelOrder order;
+	if (!GetChannelOrder(dstMode, order)) {
+		return false;
+	}
+
+	switch (mode) {
+		case 10: DecodeBlocks(src, width, height, dst, 8, 4, DecodeDXT1Block, order, flipY); return true; //DXT1
+		case 12: DecodeBlocks(src, width, height, dst, 16, 4, DecodeDXT5Block, order, flipY); return true; //DXT5
+		case 26: DecodeBlocks(src, width, height, dst, 8, 4, DecodeBC4Block, order, flipY); return true; //BC4
+		case 27: DecodeBlocks(src, width, height, dst, 16, 4, DecodeBC5Block, order, flipY); return true; //BC5
+		case 24: DecodeBlocks(src, width, height, dst, 16, 4, DecodeBC6HBlockUnorm8, order, flipY); return true; //BC6H
+		case 25: DecodeBlocks(src, width, height, dst, 16, 4, DecodeBC7Block, order, flipY); return true; //BC7
+		default: return false;
+	}
+}
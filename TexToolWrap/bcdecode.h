@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// decodes dxt1 (10), dxt5 (12), bc4 (26), bc5 (27), bc6h (24) or bc7 (25)
+// blocks straight into the pixel layout of dstMode: rgba32 (4), bgra32 (14)
+// or argb32 (5). bc6h can also go to rgbahalf (17) to keep the hdr range.
+// bc4 comes out as red only and bc5 as red/green, like unity shows them.
+// edge blocks are clipped, so dst has to fit exactly width * height pixels.
+// flipY writes the rows bottom up. returns false for combos it doesn't handle.
+bool DecodeBCSurface(int mode, int dstMode, const uint8_t* src, unsigned int width, unsigned int height, uint8_t* dst, bool flipY);
+
+// bytes per pixel of the dstModes above, 0 if it isn't one
+int GetBCDecodePixelSize(int dstMode);
+
+// cheap thumbnail of a bcn surface: every blockStep-th block in each direction
+// becomes one pixel holding the average of that block, the rest are skipped.
+// dst gets GetBCPreviewSize pixels in dstMode (rgba32, bgra32 or argb32 only).
+bool DecodeBCPreview(int mode, int dstMode, const uint8_t* src, unsigned int width, unsigned int height, unsigned int blockStep, uint8_t* dst, bool flipY);
+
+void GetBCPreviewSize(unsigned int width, unsigned int height, unsigned int blockStep, unsigned int& outWidth, unsigned int& outHeight);
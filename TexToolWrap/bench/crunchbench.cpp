@@ -0,0 +1,112 @@
+// times EncodeByCrunchUnity with different helper thread counts so we can see
+// how crunch scales on a machine, then what each quality level costs in time
+// and bits per texel. not part of the library, build it with
+// `make bench` and run bench/crunchbench [size] [mode] [level] [runs]
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdint.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+typedef void (*EncodeProgressFunc)(unsigned int done, unsigned int total, void* userData);
+
+struct CrunchEncodeSettings {
+	int qualityLevel;
+	float targetBitrate;
+	unsigned int actualQualityLevel;
+	float actualBitrate;
+	float encodeTimeMs;
+};
+
+extern "C" {
+unsigned int EncodeByCrunchUnity(void* data, int* checkoutId, int mode, int level, unsigned int width, unsigned int height, unsigned int ver, int mips, bool flipY,
+	int helperThreads, CrunchEncodeSettings* settings, EncodeProgressFunc progress, void* progressData);
+bool ReleaseResult(int id);
+}
+
+// something with both gradients and noise so crunch has real work to do
+static std::vector<uint8_t> MakeImage(unsigned int size) {
+	std::vector<uint8_t> image((size_t)size * size * 4);
+	uint32_t seed = 12345;
+	for (unsigned int y = 0; y < size; y++) {
+		for (unsigned int x = 0; x < size; x++) {
+			seed = seed * 1664525 + 1013904223;
+			uint8_t* pixel = &image[((size_t)y * size + x) * 4];
+			pixel[0] = (uint8_t)(x * 255 / size);
+			pixel[1] = (uint8_t)(y * 255 / size);
+			pixel[2] = (uint8_t)(((x ^ y) & 0x3f) + (seed >> 26));
+			pixel[3] = 255;
+		}
+	}
+	return image;
+}
+
+// best of runs, in ms. returns a negative number if the encode failed
+static double TimeEncode(std::vector<uint8_t>& image, unsigned int size, int mode, int level, int helperThreads, int runs, CrunchEncodeSettings* settings = nullptr) {
+	double best = -1;
+	for (int i = 0; i < runs; i++) {
+		int checkoutId = -1;
+		auto start = std::chrono::steady_clock::now();
+		unsigned int encodedSize = EncodeByCrunchUnity(image.data(), &checkoutId, mode, level, size, size, 1, 1, false, helperThreads, settings, nullptr, nullptr);
+		auto end = std::chrono::steady_clock::now();
+		if (encodedSize == 0) {
+			return -1;
+		}
+		ReleaseResult(checkoutId);
+
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		if (best < 0 || ms < best) {
+			best = ms;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char** argv) {
+	unsigned int size = argc > 1 ? (unsigned int)atoi(argv[1]) : 1024;
+	int mode = argc > 2 ? atoi(argv[2]) : 29; // crunched dxt5
+	int level = argc > 3 ? atoi(argv[3]) : 2;
+	int runs = argc > 4 ? std::max(atoi(argv[4]), 1) : 3;
+
+	int hardwareThreads = (int)std::max(std::thread::hardware_concurrency(), 1u);
+	printf("%ux%u mode %d level %d, best of %d, %d hardware threads\n", size, size, mode, level, runs, hardwareThreads);
+
+	std::vector<uint8_t> image = MakeImage(size);
+
+	// 0 helpers is the baseline, then powers of two up to crnlib's cap (15)
+	std::vector<int> counts = { 0, 1, 3, 7, 15 };
+	if (std::find(counts.begin(), counts.end(), hardwareThreads - 1) == counts.end()) {
+		counts.push_back(std::min(hardwareThreads - 1, 15));
+		std::sort(counts.begin(), counts.end());
+	}
+
+	double baseline = -1;
+	printf("helpers       ms  speedup\n");
+	for (int helperThreads : counts) {
+		double ms = TimeEncode(image, size, mode, level, helperThreads, runs);
+		if (ms < 0) {
+			printf("%7d   encode failed\n", helperThreads);
+			continue;
+		}
+		if (baseline < 0) {
+			baseline = ms;
+		}
+		printf("%7d %8.1f %7.2fx\n", helperThreads, ms, baseline / ms);
+	}
+
+	// what the quality knob buys, with the default helper count
+	printf("\nquality       ms  bits/texel\n");
+	for (int qualityLevel : { 32, 64, 128, 192, 255 }) {
+		CrunchEncodeSettings settings = {};
+		settings.qualityLevel = qualityLevel;
+		double ms = TimeEncode(image, size, mode, level, -1, runs, &settings);
+		if (ms < 0) {
+			printf("%7d   encode failed\n", qualityLevel);
+			continue;
+		}
+		printf("%7d %8.1f %11.3f\n", qualityLevel, ms, settings.actualBitrate);
+	}
+	return 0;
+}
@@ -0,0 +1,201 @@
+#include "decodecache.h"
+#include <atomic>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+static const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+static const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+static const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+static inline uint64_t Rotl64(uint64_t x, int r) {
+	return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t Read64(const uint8_t* p) {
+	uint64_t v;
+	memcpy(&v, p, 8);
+	return v;
+}
+
+static inline uint32_t Read32(const uint8_t* p) {
+	uint32_t v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint64_t HashRound(uint64_t acc, uint64_t input) {
+	acc += input * PRIME64_2;
+	acc = Rotl64(acc, 31);
+	return acc * PRIME64_1;
+}
+
+static inline uint64_t HashMergeRound(uint64_t acc, uint64_t val) {
+	acc ^= HashRound(0, val);
+	return acc * PRIME64_1 + PRIME64_4;
+}
+
+// plain xxh64, assumes a little endian machine like everything else here
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed) {
+	const uint8_t* p = (const uint8_t*)data;
+	const uint8_t* end = p + size;
+	uint64_t h;
+
+	if (size >= 32) {
+		uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+		uint64_t v2 = seed + PRIME64_2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - PRIME64_1;
+		const uint8_t* limit = end - 32;
+		do {
+			v1 = HashRound(v1, Read64(p));
+			v2 = HashRound(v2, Read64(p + 8));
+			v3 = HashRound(v3, Read64(p + 16));
+			v4 = HashRound(v4, Read64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h = Rotl64(v1, 1) + Rotl64(v2, 7) + Rotl64(v3, 12) + Rotl64(v4, 18);
+		h = HashMergeRound(h, v1);
+		h = HashMergeRound(h, v2);
+		h = HashMergeRound(h, v3);
+		h = HashMergeRound(h, v4);
+	} else {
+		h = seed + PRIME64_5;
+	}
+
+	h += (uint64_t)size;
+
+	for (; p + 8 <= end; p += 8) {
+		h ^= HashRound(0, Read64(p));
+		h = Rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+	}
+	if (p + 4 <= end) {
+		h ^= (uint64_t)Read32(p) * PRIME64_1;
+		h = Rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+		p += 4;
+	}
+	for (; p < end; p++) {
+		h ^= (*p) * PRIME64_5;
+		h = Rotl64(h, 11) * PRIME64_1;
+	}
+
+	h ^= h >> 33;
+	h *= PRIME64_2;
+	h ^= h >> 29;
+	h *= PRIME64_3;
+	h ^= h >> 32;
+	return h;
+}
+
+struct DecodeCacheKeyHash {
+	size_t operator()(const DecodeCacheKey& key) const {
+		// the content hash is already well mixed, the rest just gets folded in
+		return (size_t)(key.hash ^ ((uint64_t)key.mode << 56) ^ ((uint64_t)key.width << 32) ^ key.height ^ key.flipY);
+	}
+};
+
+struct DecodeCacheKeyEqual {
+	bool operator()(const DecodeCacheKey& a, const DecodeCacheKey& b) const {
+		return a.hash == b.hash && a.dataSize == b.dataSize && a.mode == b.mode &&
+			a.width == b.width && a.height == b.height && a.flipY == b.flipY;
+	}
+};
+
+struct DecodeCacheEntry {
+	DecodeCacheKey key;
+	std::vector<uint8_t> pixels;
+};
+
+// front of the list is the most recently used
+typedef std::list<DecodeCacheEntry> DecodeCacheList;
+
+static std::mutex cacheMutex;
+static DecodeCacheList entries;
+static std::unordered_map<DecodeCacheKey, DecodeCacheList::iterator, DecodeCacheKeyHash, DecodeCacheKeyEqual> entryMap;
+// atomic so insert can skip the copy of anything too big without locking
+static std::atomic<size_t> budgetBytes(256 * 1024 * 1024);
+static size_t usedBytes = 0;
+static uint64_t hitCount = 0;
+static uint64_t missCount = 0;
+
+// expects cacheMutex to be held
+static void EvictToBudget(size_t budget) {
+	while (usedBytes > budget && !entries.empty()) {
+		DecodeCacheEntry& oldest = entries.back();
+		usedBytes -= oldest.pixels.size();
+		entryMap.erase(oldest.key);
+		entries.pop_back();
+	}
+}
+
+bool DecodeCacheLookup(const DecodeCacheKey& key, void* outBuf, size_t outSize) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	auto it = entryMap.find(key);
+	if (it == entryMap.end() || it->second->pixels.size() != outSize) {
+		missCount++;
+		return false;
+	}
+
+	entries.splice(entries.begin(), entries, it->second);
+	memcpy(outBuf, it->second->pixels.data(), outSize);
+	hitCount++;
+	return true;
+}
+
+void DecodeCacheInsert(const DecodeCacheKey& key, const void* data, size_t size) {
+	// copy before locking, textures can be big
+	if (size == 0 || size > budgetBytes) {
+		return;
+	}
+	DecodeCacheEntry entry;
+	entry.key = key;
+	entry.pixels.assign((const uint8_t*)data, (const uint8_t*)data + size);
+
+	std::lock_guard<std::mutex> lock(cacheMutex);
+
+	// budget might have changed since the check above
+	if (size > budgetBytes) {
+		return;
+	}
+
+	// another thread might have decoded the same thing at the same time
+	auto it = entryMap.find(key);
+	if (it != entryMap.end()) {
+		entries.splice(entries.begin(), entries, it->second);
+		return;
+	}
+
+	EvictToBudget(budgetBytes - size);
+	entries.push_front(std::move(entry));
+	entryMap[key] = entries.begin();
+	usedBytes += size;
+}
+
+void DecodeCacheSetBudget(size_t bytes) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	budgetBytes = bytes;
+	EvictToBudget(budgetBytes);
+}
+
+void DecodeCacheClear() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	entries.clear();
+	entryMap.clear();
+	usedBytes = 0;
+	hitCount = 0;
+	missCount = 0;
+}
+
+void DecodeCacheGetStats(uint64_t& hits, uint64_t& misses, uint64_t& used, uint64_t& entryCount) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	hits = hitCount;
+	misses = missCount;
+	used = usedBytes;
+	entryCount = entries.size();
+}
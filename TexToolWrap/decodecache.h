@@ -0,0 +1,30 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// 64 bit xxhash of the bytes, fast enough that hashing a texture costs
+// nothing next to decoding it
+uint64_t HashBytes(const void* data, size_t size, uint64_t seed);
+
+// what a decode came from. the hash covers the encoded bytes, the rest is
+// there so the same bytes read as something else don't collide.
+struct DecodeCacheKey {
+	uint64_t hash;
+	uint32_t dataSize;
+	int mode;
+	unsigned int width;
+	unsigned int height;
+	bool flipY;
+};
+
+// lru cache of decoded pixels, limited by total bytes. everything locks, so
+// any thread can use it. decodes themselves run outside the lock.
+
+// copies the cached pixels to outBuf if key is there and exactly outSize long
+bool DecodeCacheLookup(const DecodeCacheKey& key, void* outBuf, size_t outSize);
+// stores a copy, dropping the least recently used entries to stay in budget
+void DecodeCacheInsert(const DecodeCacheKey& key, const void* data, size_t size);
+// 0 turns the cache off and empties it
+void DecodeCacheSetBudget(size_t bytes);
+void DecodeCacheClear();
+void DecodeCacheGetStats(uint64_t& hits, uint64_t& misses, uint64_t& usedBytes, uint64_t& entryCount);
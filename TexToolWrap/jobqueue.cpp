@@ -0,0 +1,186 @@
+#include "jobqueue.h"
+#include "resulttable.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+// two runners so a slow encode doesn't hold up a quick decode behind it
+#define JOB_RUNNER_COUNT 2
+
+struct JobContext {
+	JobFunc func;
+	std::atomic<bool> cancelled;
+	// the rest only changes under the queue lock
+	JobStatus status;
+	int result;
+	bool released;
+};
+
+static thread_local JobContext* currentJob = nullptr;
+
+JobContext* GetCurrentJob() {
+	return currentJob;
+}
+
+bool IsJobCancelled(const JobContext* job) {
+	return job != nullptr && job->cancelled.load(std::memory_order_relaxed);
+}
+
+class JobQueue {
+public:
+	JobQueue() : nextId(1) {
+		for (int i = 0; i < JOB_RUNNER_COUNT; i++) {
+			std::thread(&JobQueue::RunnerMain, this).detach();
+		}
+	}
+
+	int Submit(JobFunc func) {
+		std::shared_ptr<JobContext> job = std::make_shared<JobContext>();
+		job->func = std::move(func);
+		job->cancelled = false;
+		job->status = JOB_QUEUED;
+		job->result = -1;
+		job->released = false;
+
+		int id;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			id = nextId++;
+			jobs[id] = job;
+			queue.push_back(job);
+		}
+		queueCv.notify_one();
+		return id;
+	}
+
+	JobStatus Poll(int id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = jobs.find(id);
+		return it != jobs.end() ? it->second->status : JOB_INVALID;
+	}
+
+	JobStatus Wait(int id, int timeoutMs) {
+		std::unique_lock<std::mutex> lock(mutex);
+		auto it = jobs.find(id);
+		if (it == jobs.end()) {
+			return JOB_INVALID;
+		}
+
+		std::shared_ptr<JobContext> job = it->second;
+		auto finished = [&job] { return job->status != JOB_QUEUED && job->status != JOB_RUNNING; };
+		if (timeoutMs < 0) {
+			doneCv.wait(lock, finished);
+		} else {
+			doneCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), finished);
+		}
+		return job->status;
+	}
+
+	bool Cancel(int id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = jobs.find(id);
+		if (it == jobs.end()) {
+			return false;
+		}
+
+		JobContext& job = *it->second;
+		job.cancelled = true;
+		if (job.status == JOB_QUEUED) {
+			// the runner drops it when it comes up
+			job.status = JOB_CANCELLED;
+			doneCv.notify_all();
+		}
+		return true;
+	}
+
+	int Release(int id) {
+		std::lock_guard<std::mutex> lock(mutex);
+		auto it = jobs.find(id);
+		if (it == jobs.end()) {
+			return -1;
+		}
+
+		std::shared_ptr<JobContext> job = it->second;
+		jobs.erase(it);
+		if (job->status == JOB_DONE) {
+			return job->result;
+		}
+
+		job->cancelled = true;
+		job->released = true;
+		return -1;
+	}
+
+private:
+	void RunnerMain() {
+		while (true) {
+			std::shared_ptr<JobContext> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				queueCv.wait(lock, [this] { return !queue.empty(); });
+				job = std::move(queue.front());
+				queue.pop_front();
+				if (job->cancelled) {
+					job->status = JOB_CANCELLED;
+					doneCv.notify_all();
+					continue;
+				}
+				job->status = JOB_RUNNING;
+			}
+
+			currentJob = job.get();
+			int result = job->func();
+			currentJob = nullptr;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (job->cancelled || job->released) {
+				if (result >= 0) {
+					ResultTableRelease(result);
+				}
+				job->status = JOB_CANCELLED;
+			} else {
+				job->result = result;
+				job->status = result >= 0 ? JOB_DONE : JOB_FAILED;
+			}
+			doneCv.notify_all();
+		}
+	}
+
+	std::unordered_map<int, std::shared_ptr<JobContext>> jobs;
+	std::deque<std::shared_ptr<JobContext>> queue;
+	std::mutex mutex;
+	std::condition_variable queueCv;
+	std::condition_variable doneCv;
+	int nextId;
+};
+
+// never destroyed, same reason as the thread pool
+static JobQueue& GetJobQueue() {
+	static JobQueue* queue = new JobQueue();
+	return *queue;
+}
+
+int JobSubmit(JobFunc func) {
+	return GetJobQueue().Submit(std::move(func));
+}
+
+JobStatus JobPoll(int id) {
+	return GetJobQueue().Poll(id);
+}
+
+JobStatus JobWait(int id, int timeoutMs) {
+	return GetJobQueue().Wait(id, timeoutMs);
+}
+
+bool JobCancel(int id) {
+	return GetJobQueue().Cancel(id);
+}
+
+int JobRelease(int id) {
+	return GetJobQueue().Release(id);
+}
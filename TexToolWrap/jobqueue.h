@@ -0,0 +1,38 @@
+#pragma once
+#include <functional>
+
+// runs work in the background so the managed side doesn't block on it.
+// jobs get their own runner threads (the work itself uses the ParallelFor
+// pool) and can be polled, waited on and cancelled from any thread.
+// ids are never reused, so a stale id just reads as JOB_INVALID.
+
+enum JobStatus {
+	JOB_INVALID = -1,
+	JOB_QUEUED = 0,
+	JOB_RUNNING = 1,
+	JOB_DONE = 2,
+	JOB_FAILED = 3,
+	JOB_CANCELLED = 4
+};
+
+struct JobContext;
+
+// the job running on the calling thread, null outside of one. long running
+// work looks it up before fanning out and checks it between strips and mips.
+JobContext* GetCurrentJob();
+// false for a null job, so code outside of jobs can just call it
+bool IsJobCancelled(const JobContext* job);
+
+// the work returns a result table handle, or -1 if it failed
+typedef std::function<int()> JobFunc;
+
+int JobSubmit(JobFunc func);
+JobStatus JobPoll(int id);
+// timeoutMs < 0 waits until the job finishes
+JobStatus JobWait(int id, int timeoutMs);
+// a queued job never starts, a running one stops at its next check
+bool JobCancel(int id);
+// forgets the job and returns its result handle, which the caller now owns
+// (-1 if it didn't finish). a job that's still going is cancelled and its
+// result gets released once it stops.
+int JobRelease(int id);
@@ -0,0 +1,117 @@
+#include "mappedfile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <vector>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+bool MapFileRegion(const char* path, uint64_t offset, size_t size, MappedFileRegion& region) {
+	region = MappedFileRegion();
+	if (size == 0) {
+		return false;
+	}
+
+	int wideLength = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+	if (wideLength == 0) {
+		return false;
+	}
+	std::vector<wchar_t> widePath(wideLength);
+	MultiByteToWideChar(CP_UTF8, 0, path, -1, widePath.data(), wideLength);
+
+	HANDLE file = CreateFileW(widePath.data(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || offset + size > (uint64_t)fileSize.QuadPart) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	// the view keeps the mapping (and file) alive on its own
+	CloseHandle(file);
+	if (mapping == NULL) {
+		return false;
+	}
+
+	// views have to start on the allocation granularity, not just a page
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	uint64_t mapOffset = offset - offset % info.dwAllocationGranularity;
+	size_t mapSize = (size_t)(offset - mapOffset) + size;
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, (DWORD)(mapOffset >> 32), (DWORD)mapOffset, mapSize);
+	CloseHandle(mapping);
+	if (view == NULL) {
+		return false;
+	}
+
+	region.mapBase = view;
+	region.mapSize = mapSize;
+	region.data = (const uint8_t*)view + (offset - mapOffset);
+	region.size = size;
+	return true;
+}
+
+void UnmapFileRegion(MappedFileRegion& region) {
+	if (region.mapBase != NULL) {
+		UnmapViewOfFile(region.mapBase);
+	}
+	region = MappedFileRegion();
+}
+#else
+bool MapFileRegion(const char* path, uint64_t offset, size_t size, MappedFileRegion& region) {
+	region = MappedFileRegion();
+	if (size == 0) {
+		return false;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || offset + size > (uint64_t)st.st_size) {
+		close(fd);
+		return false;
+	}
+
+	uint64_t pageSize = (uint64_t)sysconf(_SC_PAGESIZE);
+	uint64_t mapOffset = offset - offset % pageSize;
+	size_t mapSize = (size_t)(offset - mapOffset) + size;
+
+	void* view = mmap(NULL, mapSize, PROT_READ, MAP_PRIVATE, fd, (off_t)mapOffset);
+	// the mapping holds its own reference to the file
+	close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	// decoders go through blocks front to back, so let the kernel read ahead
+	posix_madvise(view, mapSize, POSIX_MADV_SEQUENTIAL);
+
+	region.mapBase = view;
+	region.mapSize = mapSize;
+	region.data = (const uint8_t*)view + (offset - mapOffset);
+	region.size = size;
+	return true;
+}
+
+void UnmapFileRegion(MappedFileRegion& region) {
+	if (region.mapBase != NULL) {
+		munmap(region.mapBase, region.mapSize);
+	}
+	region = MappedFileRegion();
+}
+#endif
@@ -0,0 +1,17 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// read only view of part of a file. nothing is read up front, the os pages
+// the region in as it gets touched.
+struct MappedFileRegion {
+	const uint8_t* data; // start of the requested region
+	size_t size;
+	void* mapBase;       // the mapping itself starts a bit earlier, at an aligned offset
+	size_t mapSize;
+};
+
+// path is utf-8. fails if the file can't be opened or the region runs past
+// the end of it.
+bool MapFileRegion(const char* path, uint64_t offset, size_t size, MappedFileRegion& region);
+void UnmapFileRegion(MappedFileRegion& region);
@@ -0,0 +1,100 @@
+#include "mipgen.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIPGEN_SSE2
+#include <emmintrin.h>
+#endif
+
+// linear values get quantized to this many steps before going back to srgb.
+// 12 bits is enough to keep every dark srgb value apart.
+#define LINEAR_STEPS 4096
+
+struct GammaTables {
+	float toLinear[256];
+	uint8_t toSRGB[LINEAR_STEPS];
+
+	GammaTables() {
+		for (int i = 0; i < 256; i++) {
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < LINEAR_STEPS; i++) {
+			float l = i / (float)(LINEAR_STEPS - 1);
+			float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1.0f / 2.4f) - 0.055f;
+			toSRGB[i] = (uint8_t)std::min(255.0f, c * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const GammaTables& GetGammaTables() {
+	static GammaTables tables;
+	return tables;
+}
+
+#ifdef MIPGEN_SSE2
+static inline __m128 LoadLinear(const GammaTables& tables, const uint8_t* p) {
+	return _mm_set_ps(p[3] * (1.0f / 255.0f), tables.toLinear[p[2]], tables.toLinear[p[1]], tables.toLinear[p[0]]);
+}
+
+static void DownsampleRow(const GammaTables& tables, const uint8_t* row0, const uint8_t* row1, int srcWidth, uint8_t* dst, int dstWidth) {
+	const __m128 quarter = _mm_set1_ps(0.25f);
+	// rgb goes to the gamma table index, alpha straight back to 0-255
+	const __m128 outScale = _mm_set_ps(255.0f, LINEAR_STEPS - 1, LINEAR_STEPS - 1, LINEAR_STEPS - 1);
+	const __m128 half = _mm_set1_ps(0.5f);
+
+	for (int x = 0; x < dstWidth; x++) {
+		int x0 = std::min(x * 2, srcWidth - 1) * 4;
+		int x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+
+		__m128 sum = _mm_add_ps(
+			_mm_add_ps(LoadLinear(tables, row0 + x0), LoadLinear(tables, row0 + x1)),
+			_mm_add_ps(LoadLinear(tables, row1 + x0), LoadLinear(tables, row1 + x1)));
+
+		__m128i idx = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(sum, quarter), outScale), half));
+
+		alignas(16) int32_t out[4];
+		_mm_store_si128((__m128i*)out, idx);
+		dst[x * 4 + 0] = tables.toSRGB[out[0]];
+		dst[x * 4 + 1] = tables.toSRGB[out[1]];
+		dst[x * 4 + 2] = tables.toSRGB[out[2]];
+		dst[x * 4 + 3] = (uint8_t)out[3];
+	}
+}
+#else
+static void DownsampleRow(const GammaTables& tables, const uint8_t* row0, const uint8_t* row1, int srcWidth, uint8_t* dst, int dstWidth) {
+	for (int x = 0; x < dstWidth; x++) {
+		int x0 = std::min(x * 2, srcWidth - 1) * 4;
+		int x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+
+		for (int c = 0; c < 3; c++) {
+			float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] +
+				tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+			dst[x * 4 + c] = tables.toSRGB[(int)(sum * 0.25f * (LINEAR_STEPS - 1) + 0.5f)];
+		}
+
+		int alphaSum = row0[x0 + 3] + row0[x1 + 3] + row1[x0 + 3] + row1[x1 + 3];
+		dst[x * 4 + 3] = (uint8_t)((alphaSum + 2) >> 2);
+	}
+}
+#endif
+
+void DownsampleRGBA(const uint8_t* src, int srcWidth, int srcHeight, int srcStride, uint8_t* dst, int dstWidth, int dstHeight) {
+	const GammaTables& tables = GetGammaTables();
+
+	// rows are tiny on their own, so hand out a few at a time
+	const int rowsPerTask = 16;
+	int taskCount = (dstHeight + rowsPerTask - 1) / rowsPerTask;
+
+	ParallelFor(taskCount, [&](int task) {
+		int yEnd = std::min(dstHeight, (task + 1) * rowsPerTask);
+		for (int y = task * rowsPerTask; y < yEnd; y++) {
+			const uint8_t* row0 = src + (ptrdiff_t)std::min(y * 2, srcHeight - 1) * srcStride;
+			const uint8_t* row1 = src + (ptrdiff_t)std::min(y * 2 + 1, srcHeight - 1) * srcStride;
+			DownsampleRow(tables, row0, row1, srcWidth, dst + (size_t)y * dstWidth * 4, dstWidth);
+		}
+	});
+}
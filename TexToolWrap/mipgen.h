@@ -0,0 +1,7 @@
+#pragma once
+#include <stdint.h>
+
+// 2x2 box filters an rgba32 image down to the next mip level. color is
+// averaged in linear space (like crunch's gamma filtering), alpha as is.
+// dstWidth/dstHeight should be max(1, size >> 1) of the source.
+void DownsampleRGBA(const uint8_t* src, int srcWidth, int srcHeight, int srcStride, uint8_t* dst, int dstWidth, int dstHeight);
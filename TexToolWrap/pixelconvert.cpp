@@ -0,0 +1,185 @@
+#include "pixelconvert.h"
+#include "simd.h"
+#include "threadpool.h"
+#include <algorithm>
+
+#ifdef SIMD_X86
+#include <immintrin.h>
+#endif
+
+// offsets of r, g, b and a inside a pixel, -1 if the format doesn't have it
+struct PixelLayout {
+	int size;
+	int8_t offsets[4];
+};
+
+static bool GetPixelLayout(int mode, PixelLayout& layout) {
+	switch (mode) {
+		case 4:  layout = { 4, { 0, 1, 2, 3 } }; return true;     //RGBA32
+		case 14: layout = { 4, { 2, 1, 0, 3 } }; return true;     //BGRA32
+		case 5:  layout = { 4, { 1, 2, 3, 0 } }; return true;     //ARGB32
+		case 3:  layout = { 3, { 0, 1, 2, -1 } }; return true;    //RGB24
+		case 1:  layout = { 1, { -1, -1, -1, 0 } }; return true;  //Alpha8
+		default: return false;
+	}
+}
+
+int GetConvertPixelSize(int mode) {
+	PixelLayout layout;
+	return GetPixelLayout(mode, layout) ? layout.size : 0;
+}
+
+// every conversion is a byte gather: dst byte j of a pixel comes from src
+// byte map[j] of the same pixel, or is 255 if map[j] is -1. the simd kernels
+// are the same gather done with pshufb a few pixels at a time.
+struct PixelConversion {
+	int srcSize;
+	int dstSize;
+	int8_t map[4];
+	alignas(32) uint8_t mask[32];
+	alignas(32) uint8_t fill[32];
+	alignas(16) uint8_t alphaMasks[4][16];
+};
+
+typedef void (*ConvertRowFunc)(const PixelConversion& conv, const uint8_t* src, uint8_t* dst, unsigned int count);
+
+static void ConvertRowScalar(const PixelConversion& conv, const uint8_t* src, uint8_t* dst, unsigned int count) {
+	for (unsigned int i = 0; i < count; i++, src += conv.srcSize, dst += conv.dstSize) {
+		for (int j = 0; j < conv.dstSize; j++) {
+			dst[j] = conv.map[j] < 0 ? 255 : src[conv.map[j]];
+		}
+	}
+}
+
+#ifdef SIMD_X86
+// 4 pixels per step. loads and stores a full 16 bytes even for 3 byte pixels,
+// so it stops early enough to stay inside both rows and lets scalar finish.
+TARGET_SSSE3 static void ConvertRowSSSE3(const PixelConversion& conv, const uint8_t* src, uint8_t* dst, unsigned int count) {
+	const __m128i mask = _mm_load_si128((const __m128i*)conv.mask);
+	const __m128i fill = _mm_load_si128((const __m128i*)conv.fill);
+	const unsigned int margin = std::min(conv.srcSize, conv.dstSize) == 3 ? 6 : 4;
+
+	unsigned int i = 0;
+	for (; i + margin <= count; i += 4) {
+		__m128i px = _mm_loadu_si128((const __m128i*)(src + i * conv.srcSize));
+		px = _mm_or_si128(_mm_shuffle_epi8(px, mask), fill);
+		_mm_storeu_si128((__m128i*)(dst + i * conv.dstSize), px);
+	}
+
+	ConvertRowScalar(conv, src + i * conv.srcSize, dst + i * conv.dstSize, count - i);
+}
+
+// 4 byte to 4 byte only, pshufb works per 128 bit lane which is fine
+// since no pixel crosses one
+TARGET_AVX2 static void ConvertRowAVX2(const PixelConversion& conv, const uint8_t* src, uint8_t* dst, unsigned int count) {
+	const __m256i mask = _mm256_load_si256((const __m256i*)conv.mask);
+	const __m256i fill = _mm256_load_si256((const __m256i*)conv.fill);
+
+	unsigned int i = 0;
+	for (; i + 8 <= count; i += 8) {
+		__m256i px = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+		px = _mm256_or_si256(_mm256_shuffle_epi8(px, mask), fill);
+		_mm256_storeu_si256((__m256i*)(dst + i * 4), px);
+	}
+
+	ConvertRowScalar(conv, src + i * 4, dst + i * 4, count - i);
+}
+
+// 16 pixels per step. each of the 4 loads has its alphas shuffled into its
+// own quarter of the output, everything else zeroed, so they just get or'd
+TARGET_SSSE3 static void ConvertRowToAlphaSSSE3(const PixelConversion& conv, const uint8_t* src, uint8_t* dst, unsigned int count) {
+	const __m128i mask0 = _mm_load_si128((const __m128i*)conv.alphaMasks[0]);
+	const __m128i mask1 = _mm_load_si128((const __m128i*)conv.alphaMasks[1]);
+	const __m128i mask2 = _mm_load_si128((const __m128i*)conv.alphaMasks[2]);
+	const __m128i mask3 = _mm_load_si128((const __m128i*)conv.alphaMasks[3]);
+
+	unsigned int i = 0;
+	for (; i + 16 <= count; i += 16) {
+		const uint8_t* s = src + i * 4;
+		__m128i a0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 0)), mask0);
+		__m128i a1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 16)), mask1);
+		__m128i a2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 32)), mask2);
+		__m128i a3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(s + 48)), mask3);
+		_mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_or_si128(a0, a1), _mm_or_si128(a2, a3)));
+	}
+
+	ConvertRowScalar(conv, src + i * 4, dst + i, count - i);
+}
+#endif
+
+static bool BuildConversion(int srcMode, int dstMode, PixelConversion& conv) {
+	PixelLayout srcLayout;
+	PixelLayout dstLayout;
+	if (!GetPixelLayout(srcMode, srcLayout) || !GetPixelLayout(dstMode, dstLayout)) {
+		return false;
+	}
+
+	// alpha8 has no color to spread back out
+	if (srcLayout.size == 1) {
+		return false;
+	}
+
+	conv.srcSize = srcLayout.size;
+	conv.dstSize = dstLayout.size;
+	for (int c = 0; c < 4; c++) {
+		if (dstLayout.offsets[c] >= 0) {
+			conv.map[dstLayout.offsets[c]] = srcLayout.offsets[c];
+		}
+	}
+
+	// the same 16 byte pattern goes in both halves for avx2
+	for (int i = 0; i < 32; i++) {
+		int pixel = (i % 16) / conv.dstSize;
+		int j = (i % 16) % conv.dstSize;
+		bool valid = pixel < 4;
+		conv.mask[i] = (uint8_t)(valid && conv.map[j] >= 0 ? pixel * conv.srcSize + conv.map[j] : 0x80);
+		conv.fill[i] = (uint8_t)(valid && conv.map[j] < 0 ? 0xff : 0x00);
+	}
+
+	for (int q = 0; q < 4; q++) {
+		for (int i = 0; i < 16; i++) {
+			int pixel = i - q * 4;
+			conv.alphaMasks[q][i] = (uint8_t)(pixel >= 0 && pixel < 4 ? pixel * 4 + srcLayout.offsets[3] : 0x80);
+		}
+	}
+
+	return true;
+}
+
+static ConvertRowFunc PickConvertRow(const PixelConversion& conv) {
+#ifdef SIMD_X86
+	if (conv.srcSize == 4 && conv.dstSize == 4 && CpuHasAVX2()) {
+		return ConvertRowAVX2;
+	}
+	if (CpuHasSSSE3()) {
+		if (conv.dstSize == 1) {
+			return conv.srcSize == 4 ? ConvertRowToAlphaSSSE3 : ConvertRowScalar;
+		}
+		return ConvertRowSSSE3;
+	}
+#endif
+	return ConvertRowScalar;
+}
+
+bool ConvertPixelRows(const uint8_t* src, int srcMode, ptrdiff_t srcStride, uint8_t* dst, int dstMode, unsigned int width, unsigned int height) {
+	PixelConversion conv;
+	if (!BuildConversion(srcMode, dstMode, conv)) {
+		return false;
+	}
+
+	ConvertRowFunc convertRow = PickConvertRow(conv);
+	size_t dstStride = (size_t)width * conv.dstSize;
+
+	// this is all memory bandwidth, so only split up big images
+	const unsigned int rowsPerTask = std::max(1U, (256U * 1024U) / std::max(1U, width * conv.srcSize));
+	int taskCount = (int)((height + rowsPerTask - 1) / rowsPerTask);
+
+	ParallelFor(taskCount, [&](int task) {
+		unsigned int yEnd = std::min(height, (task + 1) * rowsPerTask);
+		for (unsigned int y = task * rowsPerTask; y < yEnd; y++) {
+			convertRow(conv, src + (ptrdiff_t)y * srcStride, dst + y * dstStride, width);
+		}
+	});
+
+	return true;
+}
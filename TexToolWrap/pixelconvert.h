@@ -0,0 +1,14 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// bytes per pixel of the modes ConvertPixelRows knows, 0 if it isn't one
+int GetConvertPixelSize(int mode);
+
+// reorders/expands/packs plain 8 bit pixels between rgba32 (4), bgra32 (14),
+// argb32 (5) and rgb24 (3). alpha8 (1) works as a destination only, it just
+// pulls the alpha out. missing alpha comes out as 255. dst rows are tightly
+// packed. srcStride can be negative to read the rows bottom up. src and dst
+// can be the same buffer if the pixel sizes match and rows aren't flipped.
+// returns false for pairs it doesn't handle.
+bool ConvertPixelRows(const uint8_t* src, int srcMode, ptrdiff_t srcStride, uint8_t* dst, int dstMode, unsigned int width, unsigned int height);
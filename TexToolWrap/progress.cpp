@@ -0,0 +1,66 @@
+#include "progress.h"
+
+// no point redrawing a progress bar faster than this
+#define PROGRESS_REPORT_INTERVAL_MS 50
+
+static thread_local ProgressReporter* currentProgress = nullptr;
+
+ProgressReporter::ProgressReporter(EncodeProgressFunc func, void* userData, unsigned int total, bool bindToThread)
+	: func(func), userData(userData), done(0), total(total), previous(currentProgress), bound(func != nullptr && bindToThread) {
+	lastReport = std::chrono::steady_clock::now();
+	if (bound) {
+		currentProgress = this;
+	}
+}
+
+ProgressReporter::~ProgressReporter() {
+	Report(true);
+	if (bound) {
+		currentProgress = previous;
+	}
+}
+
+void ProgressReporter::Advance(unsigned int units) {
+	done.fetch_add(units, std::memory_order_relaxed);
+	Report(false);
+}
+
+void ProgressReporter::Set(unsigned int newDone, unsigned int newTotal) {
+	total.store(newTotal, std::memory_order_relaxed);
+	done.store(newDone, std::memory_order_relaxed);
+	Report(false);
+}
+
+void ProgressReporter::Report(bool force) {
+	if (func == nullptr) {
+		return;
+	}
+
+	// skipping one while another thread reports is fine, a later one catches up
+	std::unique_lock<std::mutex> lock(reportMutex, std::defer_lock);
+	if (force) {
+		lock.lock();
+	} else if (!lock.try_lock()) {
+		return;
+	}
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (!force && now - lastReport < std::chrono::milliseconds(PROGRESS_REPORT_INTERVAL_MS)) {
+		return;
+	}
+	lastReport = now;
+
+	unsigned int reportTotal = total.load(std::memory_order_relaxed);
+	unsigned int reportDone = done.load(std::memory_order_relaxed);
+	func(reportDone < reportTotal ? reportDone : reportTotal, reportTotal, userData);
+}
+
+ProgressReporter* GetCurrentProgress() {
+	return currentProgress;
+}
+
+void ProgressAdvance(ProgressReporter* reporter, unsigned int units) {
+	if (reporter != nullptr) {
+		reporter->Advance(units);
+	}
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+// progress callback the managed side can pass to encodes. done and total are
+// block rows for ispc, levels for everything else and crunch's own phases for
+// crunch. it can come from any thread, but never from two at once.
+typedef void (*EncodeProgressFunc)(unsigned int done, unsigned int total, void* userData);
+
+// lives for one encode call. while it's alive it's the current reporter on
+// the thread that made it (unless bindToThread is false), so the encoders
+// further down can find it without passing it through everything. updates
+// only go out every so often, but the last one always goes out when it's
+// destroyed. a null func does nothing.
+class ProgressReporter {
+public:
+	ProgressReporter(EncodeProgressFunc func, void* userData, unsigned int total, bool bindToThread = true);
+	~ProgressReporter();
+
+	void Advance(unsigned int units);
+	void Set(unsigned int done, unsigned int total);
+
+private:
+	void Report(bool force);
+
+	EncodeProgressFunc func;
+	void* userData;
+	std::atomic<unsigned int> done;
+	std::atomic<unsigned int> total;
+	std::mutex reportMutex;
+	std::chrono::steady_clock::time_point lastReport;
+	ProgressReporter* previous;
+	bool bound;
+};
+
+// the reporter for the calling thread, null if there isn't one
+ProgressReporter* GetCurrentProgress();
+// null safe, like IsJobCancelled
+void ProgressAdvance(ProgressReporter* reporter, unsigned int units);
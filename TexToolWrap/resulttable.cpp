@@ -0,0 +1,127 @@
+#include "resulttable.h"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <stdint.h>
+
+// handle = generation << RESULT_INDEX_BITS | slot index
+// tag    = generation << 2 | slot state
+#define RESULT_INDEX_BITS 10
+#define RESULT_SLOT_COUNT (1 << RESULT_INDEX_BITS)
+#define RESULT_GENERATION_MASK 0xFFFFF
+
+enum ResultSlotState {
+	SLOT_FREE = 0,
+	SLOT_BUSY = 1, // being filled, copied or freed by one thread
+	SLOT_READY = 2
+};
+
+struct ResultSlot {
+	std::atomic<uint32_t> tag;
+	void* data;
+	unsigned int size;
+	ResultFreeFunc freeFunc;
+};
+
+static ResultSlot slots[RESULT_SLOT_COUNT];
+static std::atomic<uint32_t> nextSlot(0);
+
+static inline uint32_t MakeTag(uint32_t generation, ResultSlotState state) {
+	return (generation << 2) | state;
+}
+
+// moves a ready slot to busy so nobody else can free it while we use it.
+// another thread holding the same handle busy just means waiting our turn,
+// only a different generation or a free slot makes the handle invalid.
+static ResultSlot* AcquireSlot(int handle, uint32_t& generation) {
+	if (handle < 0) {
+		return NULL;
+	}
+
+	ResultSlot& slot = slots[handle & (RESULT_SLOT_COUNT - 1)];
+	generation = ((uint32_t)handle >> RESULT_INDEX_BITS) & RESULT_GENERATION_MASK;
+
+	const uint32_t readyTag = MakeTag(generation, SLOT_READY);
+	const uint32_t busyTag = MakeTag(generation, SLOT_BUSY);
+	for (int spins = 0; ; spins++) {
+		uint32_t expected = readyTag;
+		if (slot.tag.compare_exchange_weak(expected, busyTag, std::memory_order_acquire)) {
+			return &slot;
+		}
+		if (expected != readyTag && expected != busyTag) {
+			return NULL;
+		}
+
+		// the other thread may be in the middle of a big copy
+		if (spins >= 64) {
+			std::this_thread::yield();
+		}
+	}
+}
+
+int ResultTableStore(void* data, unsigned int size, ResultFreeFunc freeFunc) {
+	uint32_t start = nextSlot.fetch_add(1, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < RESULT_SLOT_COUNT; i++) {
+		uint32_t index = (start + i) & (RESULT_SLOT_COUNT - 1);
+		ResultSlot& slot = slots[index];
+
+		uint32_t tag = slot.tag.load(std::memory_order_relaxed);
+		if ((tag & 3) != SLOT_FREE) {
+			continue;
+		}
+
+		uint32_t generation = tag >> 2;
+		if (!slot.tag.compare_exchange_strong(tag, MakeTag(generation, SLOT_BUSY), std::memory_order_acquire)) {
+			continue;
+		}
+
+		slot.data = data;
+		slot.size = size;
+		slot.freeFunc = freeFunc;
+		slot.tag.store(MakeTag(generation, SLOT_READY), std::memory_order_release);
+
+		return (int)((generation << RESULT_INDEX_BITS) | index);
+	}
+	return -1;
+}
+
+bool ResultTableGetSize(int handle, unsigned int& size) {
+	uint32_t generation;
+	ResultSlot* slot = AcquireSlot(handle, generation);
+	if (slot == NULL) {
+		return false;
+	}
+
+	size = slot->size;
+	slot->tag.store(MakeTag(generation, SLOT_READY), std::memory_order_release);
+	return true;
+}
+
+bool ResultTableCopy(int handle, void* outBuf, unsigned int size) {
+	uint32_t generation;
+	ResultSlot* slot = AcquireSlot(handle, generation);
+	if (slot == NULL) {
+		return false;
+	}
+
+	memcpy(outBuf, slot->data, size < slot->size ? size : slot->size);
+	slot->tag.store(MakeTag(generation, SLOT_READY), std::memory_order_release);
+	return true;
+}
+
+bool ResultTableRelease(int handle) {
+	uint32_t generation;
+	ResultSlot* slot = AcquireSlot(handle, generation);
+	if (slot == NULL) {
+		return false;
+	}
+
+	slot->freeFunc(slot->data);
+	slot->data = NULL;
+	slot->size = 0;
+	slot->freeFunc = NULL;
+
+	// bump the generation so the old handle stops working
+	slot->tag.store(MakeTag((generation + 1) & RESULT_GENERATION_MASK, SLOT_FREE), std::memory_order_release);
+	return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+// keeps native result buffers around until the managed side picks them up.
+// handles carry a generation, so a stale or double released handle is just
+// rejected instead of touching someone else's result. lock free and safe to
+// use from any thread.
+
+typedef void (*ResultFreeFunc)(void* data);
+
+// takes ownership of data, which gets freed with freeFunc on release.
+// returns -1 if the table is full (data is left alone then).
+int ResultTableStore(void* data, unsigned int size, ResultFreeFunc freeFunc);
+bool ResultTableGetSize(int handle, unsigned int& size);
+// copies at most size bytes of the result into outBuf
+bool ResultTableCopy(int handle, void* outBuf, unsigned int size);
+bool ResultTableRelease(int handle);
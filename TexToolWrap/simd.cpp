@@ -0,0 +1,68 @@
+#include "simd.h"
+
+#ifdef SIMD_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+struct CpuFeatures {
+	bool ssse3;
+	bool sse41;
+	bool avx2;
+
+	CpuFeatures() : ssse3(false), sse41(false), avx2(false) {
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+
+		__cpuid(info, 1);
+		ssse3 = (info[2] & (1 << 9)) != 0;
+		sse41 = (info[2] & (1 << 19)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+
+		// the os also has to save the ymm registers for us
+		if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 6) == 6) {
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+		}
+#else
+		__builtin_cpu_init();
+		ssse3 = __builtin_cpu_supports("ssse3");
+		sse41 = __builtin_cpu_supports("sse4.1");
+		avx2 = __builtin_cpu_supports("avx2");
+#endif
+	}
+};
+
+static const CpuFeatures& GetCpuFeatures() {
+	static CpuFeatures features;
+	return features;
+}
+
+bool CpuHasSSSE3() {
+	return GetCpuFeatures().ssse3;
+}
+
+bool CpuHasSSE41() {
+	return GetCpuFeatures().sse41;
+}
+
+bool CpuHasAVX2() {
+	return GetCpuFeatures().avx2;
+}
+#else
+bool CpuHasSSSE3() {
+	return false;
+}
+
+bool CpuHasSSE41() {
+	return false;
+}
+
+bool CpuHasAVX2() {
+	return false;
+}
+#endif
@@ -0,0 +1,22 @@
+#pragma once
+
+// x86 feature checks for the hand written kernels. the kernels themselves
+// get compiled for their instruction set with the TARGET_ macros so the rest
+// of the library still runs on older cpus, and callers pick one at runtime.
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86
+#if defined(_MSC_VER)
+#define TARGET_SSSE3
+#define TARGET_SSE41
+#define TARGET_AVX2
+#else
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+bool CpuHasSSSE3();
+bool CpuHasSSE41();
+bool CpuHasAVX2();
@@ -0,0 +1,147 @@
+#include "switchswizzle.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#define GOB_X_UNIT_COUNT 4
+#define GOB_Y_UNIT_COUNT 8
+#define UNITS_IN_GOB (GOB_X_UNIT_COUNT * GOB_Y_UNIT_COUNT)
+#define UNIT_BYTE_SIZE 16
+#define GOB_BYTE_WIDTH (GOB_X_UNIT_COUNT * UNIT_BYTE_SIZE)
+
+// x, y of every 16 byte unit inside a gob in the order they're stored.
+// sectors are 1 unit wide and 2 tall, and a gob goes through them like this:
+//   ABIJ
+//   CDKL
+//   EFMN
+//   GHOP
+static const uint8_t gobUnitPositions[UNITS_IN_GOB][2] = {
+	{0, 0}, {0, 1}, {1, 0}, {1, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3},
+	{0, 4}, {0, 5}, {1, 4}, {1, 5}, {0, 6}, {0, 7}, {1, 6}, {1, 7},
+	{2, 0}, {2, 1}, {3, 0}, {3, 1}, {2, 2}, {2, 3}, {3, 2}, {3, 3},
+	{2, 4}, {2, 5}, {3, 4}, {3, 5}, {2, 6}, {2, 7}, {3, 6}, {3, 7}
+};
+
+struct SwitchLevel {
+	size_t linearOffset;
+	size_t rowByteSize; // plain rows are tightly packed
+	unsigned int rowCount;
+	size_t swizzledOffset;
+	unsigned int gobCountX;
+	unsigned int blockRowCount;
+	int gobsPerBlock;
+};
+
+static void GetSwitchLevels(const SwitchSurfaceInfo& info, std::vector<SwitchLevel>& levels, size_t& linearSize, size_t& swizzledSize) {
+	linearSize = 0;
+	swizzledSize = 0;
+	int gobsPerBlock = std::max(1, info.gobsPerBlock);
+	for (int i = 0; i < std::max(1, info.mips); i++) {
+		unsigned int width = std::max(1U, info.width >> i);
+		unsigned int height = std::max(1U, info.height >> i);
+
+		SwitchLevel level;
+		level.rowByteSize = (size_t)((width + info.blockWidth - 1) / info.blockWidth) * info.blockByteSize;
+		level.rowCount = (height + info.blockHeight - 1) / info.blockHeight;
+
+		// small mips don't need blocks as tall as the base level, keep
+		// halving it while half would still cover the whole level
+		if (i > 0) {
+			while (gobsPerBlock > 1 && level.rowCount <= (unsigned int)(gobsPerBlock / 2) * GOB_Y_UNIT_COUNT) {
+				gobsPerBlock /= 2;
+			}
+		}
+
+		const unsigned int blockRowHeight = GOB_Y_UNIT_COUNT * gobsPerBlock;
+		level.gobsPerBlock = gobsPerBlock;
+		level.gobCountX = (unsigned int)((level.rowByteSize + GOB_BYTE_WIDTH - 1) / GOB_BYTE_WIDTH);
+		level.blockRowCount = (level.rowCount + blockRowHeight - 1) / blockRowHeight;
+		level.linearOffset = linearSize;
+		level.swizzledOffset = swizzledSize;
+		levels.push_back(level);
+
+		linearSize += level.rowByteSize * level.rowCount;
+		swizzledSize += (size_t)level.gobCountX * GOB_BYTE_WIDTH * level.blockRowCount * blockRowHeight;
+	}
+}
+
+void GetSwitchMipsSizes(const SwitchSurfaceInfo& info, size_t& linearSize, size_t& swizzledSize) {
+	std::vector<SwitchLevel> levels;
+	GetSwitchLevels(info, levels, linearSize, swizzledSize);
+}
+
+// copies one unit that might hang off the right or bottom of the plain rows
+static void CopyEdgeUnit(const SwitchLevel& level, uint8_t* linear, uint8_t* swizzled, size_t x, size_t y, bool unswizzle) {
+	size_t count = 0;
+	if (y < level.rowCount && x < level.rowByteSize) {
+		count = std::min((size_t)UNIT_BYTE_SIZE, level.rowByteSize - x);
+	}
+
+	if (count > 0) {
+		uint8_t* linearUnit = linear + y * level.rowByteSize + x;
+		if (unswizzle) {
+			memcpy(linearUnit, swizzled, count);
+		} else {
+			memcpy(swizzled, linearUnit, count);
+		}
+	}
+	if (!unswizzle) {
+		memset(swizzled + count, 0, UNIT_BYTE_SIZE - count);
+	}
+}
+
+static void SwizzleSwitchLevel(const SwitchLevel& level, uint8_t* linear, uint8_t* swizzled, bool unswizzle) {
+	const size_t rowPitch = level.rowByteSize;
+
+	// the unit offsets only depend on the row pitch, so work them out once
+	size_t gobOffsets[UNITS_IN_GOB];
+	for (int l = 0; l < UNITS_IN_GOB; l++) {
+		gobOffsets[l] = gobUnitPositions[l][1] * rowPitch + gobUnitPositions[l][0] * UNIT_BYTE_SIZE;
+	}
+
+	// every row of blocks is its own run of swizzled bytes, so they're
+	// independent of each other
+	const size_t blockByteSize = (size_t)GOB_BYTE_WIDTH * GOB_Y_UNIT_COUNT * level.gobsPerBlock;
+	ParallelFor((int)level.blockRowCount, [&](int i) {
+		uint8_t* swizzledUnit = swizzled + (size_t)i * level.gobCountX * blockByteSize;
+		for (unsigned int j = 0; j < level.gobCountX; j++) {
+			for (int k = 0; k < level.gobsPerBlock; k++) {
+				const size_t gobX = (size_t)j * GOB_BYTE_WIDTH;
+				const size_t gobY = ((size_t)i * level.gobsPerBlock + k) * GOB_Y_UNIT_COUNT;
+
+				if (gobX + GOB_BYTE_WIDTH <= level.rowByteSize && gobY + GOB_Y_UNIT_COUNT <= level.rowCount) {
+					// most gobs are completely inside the image
+					uint8_t* gobStart = linear + gobY * rowPitch + gobX;
+					for (int l = 0; l < UNITS_IN_GOB; l++, swizzledUnit += UNIT_BYTE_SIZE) {
+						if (unswizzle) {
+							memcpy(gobStart + gobOffsets[l], swizzledUnit, UNIT_BYTE_SIZE);
+						} else {
+							memcpy(swizzledUnit, gobStart + gobOffsets[l], UNIT_BYTE_SIZE);
+						}
+					}
+				} else {
+					for (int l = 0; l < UNITS_IN_GOB; l++, swizzledUnit += UNIT_BYTE_SIZE) {
+						size_t x = gobX + gobUnitPositions[l][0] * UNIT_BYTE_SIZE;
+						size_t y = gobY + gobUnitPositions[l][1];
+						CopyEdgeUnit(level, linear, swizzledUnit, x, y, unswizzle);
+					}
+				}
+			}
+		}
+	});
+}
+
+void SwizzleSwitchMips(const SwitchSurfaceInfo& info, const uint8_t* src, uint8_t* dst, bool unswizzle) {
+	std::vector<SwitchLevel> levels;
+	size_t linearSize;
+	size_t swizzledSize;
+	GetSwitchLevels(info, levels, linearSize, swizzledSize);
+
+	// one side is only read from, it just shares the copy code
+	uint8_t* linear = unswizzle ? dst : (uint8_t*)src;
+	uint8_t* swizzled = unswizzle ? (uint8_t*)src : dst;
+	for (const SwitchLevel& level : levels) {
+		SwizzleSwitchLevel(level, linear + level.linearOffset, swizzled + level.swizzledOffset, unswizzle);
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+// size and format of a switch texture. blockWidth/blockHeight/blockByteSize
+// describe the format's own blocks (4x4 and 8 bytes for dxt1, 1x1 and 4
+// bytes for rgba32...), mips is the number of levels in the chain.
+struct SwitchSurfaceInfo {
+	unsigned int width;
+	unsigned int height;
+	int blockWidth;
+	int blockHeight;
+	int blockByteSize;
+	int gobsPerBlock;
+	int mips;
+};
+
+// bytes the whole chain takes up as plain rows (what the encoders and
+// decoders use) and in the switch's gob layout, which pads every level
+void GetSwitchMipsSizes(const SwitchSurfaceInfo& info, size_t& linearSize, size_t& swizzledSize);
+
+// moves every level between plain rows and gobs. a gob is 64 bytes wide and
+// 8 block rows tall, gobsPerBlock of them are stacked into a block and that
+// shrinks for the smaller mips like the hardware does. padding is written as
+// zeros. src and dst can't overlap.
+void SwizzleSwitchMips(const SwitchSurfaceInfo& info, const uint8_t* src, uint8_t* dst, bool unswizzle);
@@ -7,9 +7,27 @@
 #include "ispc/include/ispc_texcomp.h"
 #include "crunch/inc/crnlib.h"
 #include "crunch/inc/crn_decomp.h"
+#include "bcdecode.h"
+#include "decodecache.h"
+#include "jobqueue.h"
+#include "mappedfile.h"
+#include "mipgen.h"
+#include "pixelconvert.h"
+#include "progress.h"
+#include "resulttable.h"
+#include "switchswizzle.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <functional>
+#include <memory>
 #include <stdio.h>
-#include <map>
+#include <vector>
 
 #if defined(_MSC_VER)
 	#define EXPORT extern "C" __declspec(dllexport)
@@ -17,9 +35,6 @@
 	#define EXPORT extern "C" __attribute__((visibility("default")))
 #endif
 
-std::map<int, void*> memoryPickup;
-int nextMemoryPickupId = 0;
-
 bool GetPVRTexLibModes(int mode, PVRTuint64& pvrtlMode, PVRTexLibVariableType& pvrtlVarType) {
 	switch (mode) {
 		case 5:  pvrtlMode = PVRTGENPIXELID4('a','r','g','b', 8, 8, 8, 8); break; //ARGB32
@@ -81,7 +96,28 @@ bool GetPVRTexLibModes(int mode, PVRTuint64& pvrtlMode, PVRTexLibVariableType& p
 	return true;
 }
 
-PVRTexLibCompressorQuality GetPVRTexLibCompressionLevel(PVRTuint64 pvrtlMode) {
+// quality levels go from 0 (fastest) to 4 (best), 2 is the normal one every
+// encoder used before there was a choice. ispc's etc1 encoder only has one
+// profile, so ETC_RGB4 (which goes there) comes out the same at every level.
+#define QUALITY_LEVEL_COUNT 5
+
+static int ClampQualityLevel(int level) {
+	return std::max(0, std::min(QUALITY_LEVEL_COUNT - 1, level));
+}
+
+PVRTexLibCompressorQuality GetPVRTexLibCompressionLevel(PVRTuint64 pvrtlMode, int level) {
+	static const PVRTexLibCompressorQuality pvrtcLevels[QUALITY_LEVEL_COUNT] = {
+		PVRTLCQ_PVRTCFastest, PVRTLCQ_PVRTCFast, PVRTLCQ_PVRTCNormal, PVRTLCQ_PVRTCHigh, PVRTLCQ_PVRTCBest
+	};
+	static const PVRTexLibCompressorQuality etcLevels[QUALITY_LEVEL_COUNT] = {
+		PVRTLCQ_ETCFast, PVRTLCQ_ETCFast, PVRTLCQ_ETCNormal, PVRTLCQ_ETCSlow, PVRTLCQ_ETCSlow
+	};
+	static const PVRTexLibCompressorQuality astcLevels[QUALITY_LEVEL_COUNT] = {
+		PVRTLCQ_ASTCVeryFast, PVRTLCQ_ASTCFast, PVRTLCQ_ASTCMedium, PVRTLCQ_ASTCThorough, PVRTLCQ_ASTCExhaustive
+	};
+
+	level = ClampQualityLevel(level);
+
 	switch (pvrtlMode) {
 		case PVRTLPF_PVRTCI_2bpp_RGB:
 		case PVRTLPF_PVRTCI_2bpp_RGBA:
@@ -89,14 +125,14 @@ PVRTexLibCompressorQuality GetPVRTexLibCompressionLevel(PVRTuint64 pvrtlMode) {
 		case PVRTLPF_PVRTCI_4bpp_RGBA:
 		case PVRTLPF_PVRTCII_2bpp:
 		case PVRTLPF_PVRTCII_4bpp:
-			return PVRTLCQ_PVRTCNormal;
+			return pvrtcLevels[level];
 		case PVRTLPF_ETC1:
 		case PVRTLPF_ETC2_RGB:
 		case PVRTLPF_ETC2_RGBA:
 		case PVRTLPF_ETC2_RGB_A1:
 		case PVRTLPF_EAC_R11:
 		case PVRTLPF_EAC_RG11:
-			return PVRTLCQ_ETCNormal;
+			return etcLevels[level];
 		case PVRTLPF_ASTC_4x4:
 		case PVRTLPF_ASTC_5x4:
 		case PVRTLPF_ASTC_5x5:
@@ -121,13 +157,78 @@ PVRTexLibCompressorQuality GetPVRTexLibCompressionLevel(PVRTuint64 pvrtlMode) {
 		case PVRTLPF_ASTC_6x5x5:
 		case PVRTLPF_ASTC_6x6x5:
 		case PVRTLPF_ASTC_6x6x6:
-			return PVRTLCQ_ASTCMedium;
+			return astcLevels[level];
 		default:
-			return PVRTLCQ_PVRTCNormal;
+			return pvrtcLevels[level];
 	}
 }
 
-EXPORT unsigned int DecodeByPVRTexLib(void* data, void* outBuf, int mode, unsigned int width, unsigned int height) {
+// mirrors RGBAToFormatByteSize on the plugin side
+unsigned int GetTextureByteSize(int mode, unsigned int width, unsigned int height) {
+	unsigned int blockCountX = (width + 3) >> 2;
+	unsigned int blockCountY = (height + 3) >> 2;
+	switch (mode) {
+		case 5:  //ARGB32
+		case 14: //BGRA32
+		case 4:  //RGBA32
+		case 18: //RFloat
+		case 16: //RGHalf
+		case 22: //RGB9e5Float
+			return width * height * 4;
+		case 3:  //RGB24
+			return width * height * 3;
+		case 2:  //ARGB4444
+		case 13: //RGBA4444
+		case 7:  //RGB565
+		case 9:  //R16
+		case 62: //RG16
+		case 15: //RHalf
+		case 21: //YUY2
+			return width * height * 2;
+		case 1:  //Alpha8
+		case 63: //R8
+			return width * height;
+		case 17: //RGBAHalf
+		case 19: //RGFloat
+			return width * height * 8;
+		case 20: //RGBAFloat
+			return width * height * 16;
+		case 10: //DXT1
+		case 26: //BC4
+		case 34: //ETC_RGB4
+		case 60: //ETC_RGB4_3DS
+		case 41: //EAC_R
+		case 42: //EAC_R_SIGNED
+			return blockCountX * blockCountY * 8;
+		case 12: //DXT5
+		case 27: //BC5
+		case 24: //BC6H
+		case 25: //BC7
+		case 43: //EAC_RG
+		case 44: //EAC_RG_SIGNED
+		case 45: //ETC2_RGB4
+		case 46: //ETC2_RGBA1
+		case 47: //ETC2_RGBA8
+		case 61: //ETC_RGBA8_3DS
+			return blockCountX * blockCountY * 16;
+		case 30: //PVRTC_RGB2
+		case 31: //PVRTC_RGBA2
+			return ((width + 7) >> 3) * blockCountY * 8;
+		case 32: //PVRTC_RGB4
+		case 33: //PVRTC_RGBA4
+			return blockCountX * blockCountY * 8;
+		case 48: case 54: return ((width + 3) / 4) * ((height + 3) / 4) * 16;     //ASTC 4x4
+		case 49: case 55: return ((width + 4) / 5) * ((height + 4) / 5) * 16;     //ASTC 5x5
+		case 50: case 56: return ((width + 5) / 6) * ((height + 5) / 6) * 16;     //ASTC 6x6
+		case 51: case 57: return ((width + 7) / 8) * ((height + 7) / 8) * 16;     //ASTC 8x8
+		case 52: case 58: return ((width + 9) / 10) * ((height + 9) / 10) * 16;   //ASTC 10x10
+		case 53: case 59: return ((width + 11) / 12) * ((height + 11) / 12) * 16; //ASTC 12x12
+		default:
+			return width * height * 16; // don't know
+	}
+}
+
+EXPORT unsigned int DecodeByPVRTexLib(void* data, void* outBuf, int mode, unsigned int width, unsigned int height, bool flipY) {
 	PVRTuint64 pvrtlMode;
 	PVRTexLibVariableType pvrtlVarType;
 	
@@ -145,74 +246,750 @@ EXPORT unsigned int DecodeByPVRTexLib(void* data, void* outBuf, int mode, unsign
 	
 	void* newData = pvrt.GetTextureDataPointer();
 	unsigned int size = pvrt.GetTextureDataSize();
-	memcpy(outBuf, newData, size);
+	if (flipY) {
+		// flip while copying out instead of making the caller do another pass
+		size_t rowSize = (size_t)width * 4;
+		for (unsigned int y = 0; y < height; y++) {
+			memcpy((uint8_t*)outBuf + (height - 1 - y) * rowSize, (uint8_t*)newData + y * rowSize, rowSize);
+		}
+	} else {
+		memcpy(outBuf, newData, size);
+	}
 	return size;
 }
-EXPORT unsigned int EncodeByPVRTexLib(void* data, void* outBuf, int mode, int level, unsigned int width, unsigned int height) {
+
+// per item result of EncodeBatch
+enum EncodeStatus {
+	ENCODE_OK = 0,
+	ENCODE_UNSUPPORTED = 1,
+	ENCODE_FAILED = 2,
+	ENCODE_BUFFER_TOO_SMALL = 3
+};
+
+EncodeStatus EncodeSurfaceByPVRTexLib(const rgba_surface* surface, void* outBuf, unsigned int outBufSize, int mode, int level, unsigned int& size) {
 	PVRTuint64 pvrtlMode;
 	PVRTexLibVariableType pvrtlVarType;
 	
 	if (!GetPVRTexLibModes(mode, pvrtlMode, pvrtlVarType)) {
-		return 0;
+		return ENCODE_UNSUPPORTED;
 	}
-	PVRTexLibCompressorQuality compLevel = GetPVRTexLibCompressionLevel(pvrtlMode);
+	PVRTexLibCompressorQuality compLevel = GetPVRTexLibCompressionLevel(pvrtlMode, level);
 	
 	unsigned long long RGBA8888 = PVRTGENPIXELID4('r','g','b','a', 8,8,8,8);
-	pvrtexlib::PVRTextureHeader pvrth = pvrtexlib::PVRTextureHeader(RGBA8888, width, height);
-	pvrtexlib::PVRTexture pvrt = pvrtexlib::PVRTexture(pvrth, data);
+	pvrtexlib::PVRTextureHeader pvrth = pvrtexlib::PVRTextureHeader(RGBA8888, surface->width, surface->height);
+	bool packed = surface->stride == surface->width * 4;
+	pvrtexlib::PVRTexture pvrt = pvrtexlib::PVRTexture(pvrth, packed ? surface->ptr : NULL);
+	if (!packed) {
+		// pvrtexlib only takes tightly packed rows
+		uint8_t* texData = (uint8_t*)pvrt.GetTextureDataPointer();
+		size_t rowSize = (size_t)surface->width * 4;
+		for (int y = 0; y < surface->height; y++) {
+			memcpy(texData + y * rowSize, surface->ptr + (ptrdiff_t)y * surface->stride, rowSize);
+		}
+	}
 	
 	if (!pvrt.Transcode(pvrtlMode, pvrtlVarType, PVRTLCS_sRGB, compLevel, false)) {
-		return 0;
+		return ENCODE_FAILED;
 	}
 	
 	void* newData = pvrt.GetTextureDataPointer();
-	unsigned int size = pvrt.GetTextureDataSize();
+	size = pvrt.GetTextureDataSize();
+	if (size > outBufSize) {
+		return ENCODE_BUFFER_TOO_SMALL;
+	}
 	memcpy(outBuf, newData, size);
-	return size;
+	ProgressAdvance(GetCurrentProgress(), 1);
+	return ENCODE_OK;
 }
 
-EXPORT unsigned int EncodeByISPC(void* data, void* outBuf, int mode, int level, unsigned int width, unsigned int height) {
+// wraps a tightly packed rgba32 (or rgbahalf with pixelSize 8) image. flipped
+// surfaces start on the last row with a negative stride, so everything reading
+// them goes bottom up.
+static rgba_surface MakeSurface(void* data, unsigned int width, unsigned int height, bool flipY, int pixelSize = 4) {
 	rgba_surface surface;
 	surface.ptr = (uint8_t*)data;
 	surface.width = width;
 	surface.height = height;
-	surface.stride = width * 4;
+	surface.stride = width * pixelSize;
+	if (flipY && height > 0) {
+		surface.ptr += (size_t)(height - 1) * width * pixelSize;
+		surface.stride = -surface.stride;
+	}
+	return surface;
+}
+
+EXPORT unsigned int EncodeByPVRTexLib(void* data, void* outBuf, int mode, int level, unsigned int width, unsigned int height, bool flipY,
+	EncodeProgressFunc progress, void* progressData) {
+	ProgressReporter reporter(progress, progressData, 1);
+	rgba_surface surface = MakeSurface(data, width, height, flipY);
+
+	unsigned int size = 0;
+	if (EncodeSurfaceByPVRTexLib(&surface, outBuf, UINT_MAX, mode, level, size) != ENCODE_OK) {
+		return 0;
+	}
+	return size;
+}
+
+// ispc only encodes whole blocks, so blocks hanging off the right or bottom edge
+// get copied into a small tile with the last row/column repeated. the tile is at
+// most one block row, never the whole image.
+static void CompressEdgeTile(const rgba_surface* surface, int pixelSize, int x, int y, int tileWidth, int tileHeight, uint8_t* dst, const std::function<void(const rgba_surface*, uint8_t*)>& compress) {
+	std::vector<uint8_t> tile((size_t)tileWidth * tileHeight * pixelSize);
+
+	rgba_surface tileSurface;
+	tileSurface.ptr = tile.data();
+	tileSurface.width = tileWidth;
+	tileSurface.height = tileHeight;
+	tileSurface.stride = tileWidth * pixelSize;
+	ReplicateBorders(&tileSurface, surface, x, y, pixelSize * 8);
+
+	compress(&tileSurface, dst);
+}
+
+// block rows compress gets at once. ispc's astc encoder batches up candidate
+// blocks across a whole call, so its output depends on where the surface gets
+// cut. the cuts are every this many block rows from the top of the surface,
+// which only depends on the width, never on the thread count or on whether
+// anyone is watching progress.
+static int GetStripChunkRows(int blockCountX) {
+	return std::max(1, 4096 / blockCountX);
+}
+
+// runs compress over strips of whole block rows on the thread pool. strips are
+// made of whole GetStripChunkRows chunks, so every format (astc included) gives
+// the same bytes no matter how the work is split up.
+// the aligned part is read straight out of surface, only the ragged right
+// column and bottom row of blocks go through CompressEdgeTile.
+void CompressSurfaceStrips(const rgba_surface* surface, uint8_t* dst, int pixelSize, int blockWidth, int blockHeight, int blockByteSize, const std::function<void(const rgba_surface*, uint8_t*)>& compress) {
+	int blockCountX = (surface->width + blockWidth - 1) / blockWidth;
+	int blockRowCount = (surface->height + blockHeight - 1) / blockHeight;
+	int fullBlockCountX = surface->width / blockWidth;
+	int fullBlockRowCount = surface->height / blockHeight;
+	size_t blockRowByteSize = (size_t)blockCountX * blockByteSize;
+
+	if (blockCountX == 0 || blockRowCount == 0) {
+		return;
+	}
+
+	// a few strips per thread so one slow strip doesn't hold everything up
+	int chunkRows = GetStripChunkRows(blockCountX);
+	int chunkCount = (blockRowCount + chunkRows - 1) / chunkRows;
+	int stripCount = std::min(GetPoolThreadCount() * 4, chunkCount);
+	int rowsPerStrip = (chunkCount + stripCount - 1) / stripCount * chunkRows;
+	stripCount = (blockRowCount + rowsPerStrip - 1) / rowsPerStrip;
+
+	// the pool threads don't know which job or reporter they're helping, so look them up here.
+	// a cancelled job leaves the rest of the strips alone, the output is thrown out.
+	JobContext* job = GetCurrentJob();
+	ProgressReporter* progress = GetCurrentProgress();
+
+	auto compressStrip = [&](int strip) {
+		if (IsJobCancelled(job)) {
+			return;
+		}
+
+		int firstRow = strip * rowsPerStrip;
+		int lastRow = std::min(firstRow + rowsPerStrip, blockRowCount);
+		int lastFullRow = std::min(lastRow, fullBlockRowCount);
+
+		rgba_surface stripSurface;
+		stripSurface.stride = surface->stride;
+		stripSurface.width = fullBlockCountX * blockWidth;
+
+		if (fullBlockCountX == blockCountX) {
+			// rows are exactly what ispc writes, so each chunk is one call. that
+			// also means a cancel doesn't wait on a whole strip and the progress
+			// doesn't jump a strip at a time.
+			for (int row = firstRow; row < lastFullRow && !IsJobCancelled(job); row += chunkRows) {
+				int chunkEnd = std::min(row + chunkRows, lastFullRow);
+				stripSurface.ptr = surface->ptr + (ptrdiff_t)row * blockHeight * surface->stride;
+				stripSurface.height = (chunkEnd - row) * blockHeight;
+				compress(&stripSurface, dst + row * blockRowByteSize);
+				ProgressAdvance(progress, chunkEnd - row);
+			}
+		} else {
+			// ispc would pack the rows too tight, so go a block row at a time
+			for (int row = firstRow; row < lastFullRow && !IsJobCancelled(job); row++) {
+				uint8_t* rowDst = dst + row * blockRowByteSize;
+				if (fullBlockCountX > 0) {
+					stripSurface.ptr = surface->ptr + (ptrdiff_t)row * blockHeight * surface->stride;
+					stripSurface.height = blockHeight;
+					compress(&stripSurface, rowDst);
+				}
+				CompressEdgeTile(surface, pixelSize, fullBlockCountX * blockWidth, row * blockHeight, blockWidth, blockHeight,
+					rowDst + (size_t)fullBlockCountX * blockByteSize, compress);
+				ProgressAdvance(progress, 1);
+			}
+		}
+
+		if (lastRow > fullBlockRowCount) {
+			CompressEdgeTile(surface, pixelSize, 0, fullBlockRowCount * blockHeight, blockCountX * blockWidth, blockHeight,
+				dst + fullBlockRowCount * blockRowByteSize, compress);
+			ProgressAdvance(progress, 1);
+		}
+	};
+
+	if (stripCount <= 1) {
+		compressStrip(0);
+	} else {
+		ParallelFor(stripCount, compressStrip);
+	}
+}
+
+// block layout of the modes EncodeSurfaceByISPC handles
+bool GetISPCBlockInfo(int mode, int& blockWidth, int& blockHeight, int& blockByteSize) {
+	blockWidth = 4;
+	blockHeight = 4;
+	switch (mode) {
+		case 10: blockByteSize = 8; return true;  //DXT1
+		case 12: blockByteSize = 16; return true; //DXT5
+		case 26: blockByteSize = 8; return true;  //BC4
+		case 27: blockByteSize = 16; return true; //BC5
+		case 24: blockByteSize = 16; return true; //BC6H
+		case 25: blockByteSize = 16; return true; //BC7
+		case 34: blockByteSize = 8; return true;  //ETC_RGB4
+		// ispc's astc encoder tops out at 8x8, 10x10 and 12x12 stay on pvrtexlib
+		case 48: case 54: blockByteSize = 16; return true; //ASTC_RGB(A)_4x4
+		case 49: case 55: blockWidth = blockHeight = 5; blockByteSize = 16; return true; //ASTC_RGB(A)_5x5
+		case 50: case 56: blockWidth = blockHeight = 6; blockByteSize = 16; return true; //ASTC_RGB(A)_6x6
+		case 51: case 57: blockWidth = blockHeight = 8; blockByteSize = 16; return true; //ASTC_RGB(A)_8x8
+		default: return false;
+	}
+}
 
-	int blockCountX = (width + 3) >> 2;
-	int blockCountY = (height + 3) >> 2;
-	int blockByteSize = 0;
+// how many progress units an encode of one level counts for. ispc reports
+// each block row, everything else only when the whole level is done.
+static unsigned int GetEncodeProgressUnits(int mode, unsigned int height) {
+	int blockWidth, blockHeight, blockByteSize;
+	if (GetISPCBlockInfo(mode, blockWidth, blockHeight, blockByteSize)) {
+		return (height + blockHeight - 1) / blockHeight;
+	}
+	return 1;
+}
+
+// ispc wants bc4 as r8 and bc5 as rg8, so each strip gets packed down into its
+// own scratch buffer first. that way only a strip is ever copied at a time.
+static void CompressStripChannels(const rgba_surface* src, uint8_t* dst, int channels, void (*compress)(const rgba_surface*, uint8_t*)) {
+	std::vector<uint8_t> packed((size_t)src->width * src->height * channels);
+	for (int y = 0; y < src->height; y++) {
+		const uint8_t* srcRow = src->ptr + (ptrdiff_t)y * src->stride;
+		uint8_t* packedRow = packed.data() + (size_t)y * src->width * channels;
+		for (int x = 0; x < src->width; x++) {
+			for (int c = 0; c < channels; c++) {
+				packedRow[x * channels + c] = srcRow[x * 4 + c];
+			}
+		}
+	}
+
+	rgba_surface packedSurface;
+	packedSurface.ptr = packed.data();
+	packedSurface.width = src->width;
+	packedSurface.height = src->height;
+	packedSurface.stride = src->width * channels;
+	compress(&packedSurface, dst);
+}
+
+static uint16_t FloatToHalf(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, 4);
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	if (exponent >= 31) {
+		// too big (or inf/nan), clamp to inf
+		return sign | 0x7c00;
+	}
+	if (exponent <= 0) {
+		// denormal or zero
+		if (exponent < -10) {
+			return sign;
+		}
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		// round to nearest
+		if ((mantissa >> (shift - 1)) & 1) {
+			half++;
+		}
+		return sign | (uint16_t)half;
+	}
+
+	uint16_t half = sign | (uint16_t)(exponent << 10) | (uint16_t)(mantissa >> 13);
+	// round to nearest, a carry into the exponent is still correct
+	if (mantissa & 0x1000) {
+		half++;
+	}
+	return half;
+}
+
+// all 256 unorm8 values as halfs, so widening a pixel is just a lookup
+struct UnormHalfTable {
+	uint16_t values[256];
+	UnormHalfTable() {
+		for (int i = 0; i < 256; i++) {
+			values[i] = FloatToHalf(i / 255.0f);
+		}
+	}
+};
+
+// bc6h only takes rgbahalf, so rgba32 strips get widened into scratch first
+static void CompressStripBC6H(const rgba_surface* src, uint8_t* dst, bc6h_enc_settings* settings) {
+	static const UnormHalfTable table;
+
+	std::vector<uint16_t> halfs((size_t)src->width * src->height * 4);
+	for (int y = 0; y < src->height; y++) {
+		const uint8_t* srcRow = src->ptr + (ptrdiff_t)y * src->stride;
+		uint16_t* halfRow = halfs.data() + (size_t)y * src->width * 4;
+		for (int i = 0; i < src->width * 4; i++) {
+			halfRow[i] = table.values[srcRow[i]];
+		}
+	}
+
+	rgba_surface halfSurface;
+	halfSurface.ptr = (uint8_t*)halfs.data();
+	halfSurface.width = src->width;
+	halfSurface.height = src->height;
+	halfSurface.stride = src->width * 8;
+	CompressBlocksBC6H(&halfSurface, dst, settings);
+}
+
+static void GetBC6HProfile(int level, bc6h_enc_settings* settings) {
+	typedef void (*BC6HProfileFunc)(bc6h_enc_settings* settings);
+	static const BC6HProfileFunc bc6hProfiles[QUALITY_LEVEL_COUNT] = {
+		GetProfile_bc6h_veryfast, GetProfile_bc6h_fast, GetProfile_bc6h_basic, GetProfile_bc6h_slow, GetProfile_bc6h_veryslow
+	};
+	bc6hProfiles[ClampQualityLevel(level)](settings);
+}
+
+unsigned int EncodeSurfaceByISPC(const rgba_surface* surface, uint8_t* dst, int mode, int level) {
+	int blockWidth, blockHeight, blockByteSize;
+	if (!GetISPCBlockInfo(mode, blockWidth, blockHeight, blockByteSize)) {
+		return 0;
+	}
+
+	int blockCountX = (surface->width + blockWidth - 1) / blockWidth;
+	int blockCountY = (surface->height + blockHeight - 1) / blockHeight;
 
 	if (mode == 10) { //DXT1
-		CompressBlocksBC1(&surface, (uint8_t*)outBuf);
-		blockByteSize = 8;
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [](const rgba_surface* src, uint8_t* dst) {
+			CompressBlocksBC1(src, dst);
+		});
 	} else if (mode == 12) { //DXT5
-		CompressBlocksBC3(&surface, (uint8_t*)outBuf);
-		blockByteSize = 16;
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [](const rgba_surface* src, uint8_t* dst) {
+			CompressBlocksBC3(src, dst);
+		});
 	}
 	else if (mode == 26) { // BC4
-		CompressBlocksBC4(&surface, (uint8_t*)outBuf);
-		blockByteSize = 8;
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [](const rgba_surface* src, uint8_t* dst) {
+			CompressStripChannels(src, dst, 1, CompressBlocksBC4);
+		});
 	}
 	else if (mode == 27) { // BC5
-		CompressBlocksBC5(&surface, (uint8_t*)outBuf);
-		blockByteSize = 16;
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [](const rgba_surface* src, uint8_t* dst) {
+			CompressStripChannels(src, dst, 2, CompressBlocksBC5);
+		});
 	} else if (mode == 24) { // BC6H
 		bc6h_enc_settings bc6hsettings;
-		GetProfile_bc6h_basic(&bc6hsettings);
-		CompressBlocksBC6H(&surface, (uint8_t*)outBuf, &bc6hsettings);
-		blockByteSize = 16;
+		GetBC6HProfile(level, &bc6hsettings);
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [&bc6hsettings](const rgba_surface* src, uint8_t* dst) {
+			// settings are only read, so sharing one copy between strips is fine
+			CompressStripBC6H(src, dst, &bc6hsettings);
+		});
 	} else if (mode == 25) { //BC7
+		// no veryslow for bc7, slow is as good as it gets
+		typedef void (*BC7ProfileFunc)(bc7_enc_settings* settings);
+		static const BC7ProfileFunc bc7Profiles[QUALITY_LEVEL_COUNT] = {
+			GetProfile_alpha_ultrafast, GetProfile_alpha_veryfast, GetProfile_alpha_basic, GetProfile_alpha_slow, GetProfile_alpha_slow
+		};
 		bc7_enc_settings bc7settings;
-		GetProfile_alpha_basic(&bc7settings); //GetProfile_alpha_slow
-		CompressBlocksBC7(&surface, (uint8_t*)outBuf, &bc7settings);
-		blockByteSize = 16;
-	} else {
-		return 0;
+		bc7Profiles[ClampQualityLevel(level)](&bc7settings);
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [&bc7settings](const rgba_surface* src, uint8_t* dst) {
+			CompressBlocksBC7(src, dst, &bc7settings);
+		});
+	} else if (mode == 34) { //ETC_RGB4
+		// only one etc profile, so every level gets it
+		etc_enc_settings etcsettings;
+		GetProfile_etc_slow(&etcsettings);
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [&etcsettings](const rgba_surface* src, uint8_t* dst) {
+			CompressBlocksETC1(src, dst, &etcsettings);
+		});
+	} else { //ASTC
+		// rgb only has the fast profile. rgba gets the slow one for the top levels.
+		astc_enc_settings astcsettings;
+		if (mode <= 53) {
+			GetProfile_astc_fast(&astcsettings, blockWidth, blockHeight);
+		} else if (ClampQualityLevel(level) <= 2) {
+			GetProfile_astc_alpha_fast(&astcsettings, blockWidth, blockHeight);
+		} else {
+			GetProfile_astc_alpha_slow(&astcsettings, blockWidth, blockHeight);
+		}
+		CompressSurfaceStrips(surface, dst, 4, blockWidth, blockHeight, blockByteSize, [&astcsettings](const rgba_surface* src, uint8_t* dst) {
+			CompressBlocksASTC(src, dst, &astcsettings);
+		});
 	}
 
 	return blockCountX * blockCountY * blockByteSize;
 }
 
+EXPORT unsigned int EncodeByISPC(void* data, void* outBuf, int mode, int level, unsigned int width, unsigned int height, bool flipY,
+	EncodeProgressFunc progress, void* progressData) {
+	ProgressReporter reporter(progress, progressData, GetEncodeProgressUnits(mode, height));
+	rgba_surface surface = MakeSurface(data, width, height, flipY);
+
+	return EncodeSurfaceByISPC(&surface, (uint8_t*)outBuf, mode, level);
+}
+
+// same as EncodeByISPC but takes rgbahalf pixels, so hdr sources keep their
+// precision. only bc6h (24) can use them.
+EXPORT unsigned int EncodeHalfByISPC(void* data, void* outBuf, int mode, int level, unsigned int width, unsigned int height, bool flipY,
+	EncodeProgressFunc progress, void* progressData) {
+	if (mode != 24) {
+		return 0;
+	}
+
+	ProgressReporter reporter(progress, progressData, (height + 3) >> 2);
+	rgba_surface surface = MakeSurface(data, width, height, flipY, 8);
+
+	bc6h_enc_settings bc6hsettings;
+	GetBC6HProfile(level, &bc6hsettings);
+	CompressSurfaceStrips(&surface, (uint8_t*)outBuf, 8, 4, 4, 16, [&bc6hsettings](const rgba_surface* src, uint8_t* dst) {
+		CompressBlocksBC6H(src, dst, &bc6hsettings);
+	});
+
+	return ((width + 3) >> 2) * ((height + 3) >> 2) * 16;
+}
+
+// surface descriptor for EncodeBatch. size and status are written back.
+struct EncodeBatchItem {
+	void* data;
+	unsigned int width;
+	unsigned int height;
+	unsigned int stride; // in bytes, 0 for tightly packed rgba32
+	int mode;
+	int level;
+	int mips; // levels to generate and encode, 0 is the same as 1
+	int flipY; // nonzero reads the base level bottom up
+	void* outBuf;
+	unsigned int outBufSize;
+	unsigned int size;
+	int status;
+};
+
+// picks the same encoder the plugin would for a single mip
+EncodeStatus EncodeSurfaceByMode(const rgba_surface* surface, void* outBuf, unsigned int outBufSize, int mode, int level, unsigned int& size) {
+	size = 0;
+	switch (mode) {
+		case 10: //DXT1
+		case 12: //DXT5
+		case 25: //BC7
+		case 24: //BC6H
+		case 26: //BC4
+		case 27: //BC5
+		case 34: //ETC_RGB4
+		case 48: case 49: case 50: case 51: //ASTC_RGB 4x4-8x8
+		case 54: case 55: case 56: case 57: //ASTC_RGBA 4x4-8x8
+		{
+			if (GetTextureByteSize(mode, surface->width, surface->height) > outBufSize) {
+				return ENCODE_BUFFER_TOO_SMALL;
+			}
+			size = EncodeSurfaceByISPC(surface, (uint8_t*)outBuf, mode, level);
+			return size > 0 ? ENCODE_OK : ENCODE_FAILED;
+		}
+		case 4:  //RGBA32
+		case 14: //BGRA32
+		case 5:  //ARGB32
+		case 3:  //RGB24
+		case 1:  //Alpha8
+		{
+			// just a shuffle, no need to spin up pvrtexlib for these
+			unsigned long long needed = (unsigned long long)surface->width * surface->height * GetConvertPixelSize(mode);
+			if (needed > outBufSize) {
+				return ENCODE_BUFFER_TOO_SMALL;
+			}
+			if (!ConvertPixelRows(surface->ptr, 4, surface->stride, (uint8_t*)outBuf, mode, surface->width, surface->height)) {
+				return ENCODE_FAILED;
+			}
+			size = (unsigned int)needed;
+			ProgressAdvance(GetCurrentProgress(), 1);
+			return ENCODE_OK;
+		}
+		default:
+			return EncodeSurfaceByPVRTexLib(surface, outBuf, outBufSize, mode, level, size);
+	}
+}
+
+// encodes surface and the mips generated from it back to back into outBuf.
+// size is the total written, only valid if it returns ENCODE_OK.
+static EncodeStatus EncodeMipChain(rgba_surface surface, void* outBuf, unsigned int outBufSize, int mode, int level, int mips, unsigned int& size) {
+	size = 0;
+	if (mips < 1) {
+		mips = 1;
+	}
+
+	// scratch space for every level after the base one, about a third of the base size
+	size_t scratchSize = 0;
+	unsigned int mipWidth = surface.width;
+	unsigned int mipHeight = surface.height;
+	for (int i = 1; i < mips; i++) {
+		mipWidth = std::max(1U, mipWidth >> 1);
+		mipHeight = std::max(1U, mipHeight >> 1);
+		scratchSize += (size_t)mipWidth * mipHeight * 4;
+	}
+
+	std::vector<uint8_t> scratch(scratchSize);
+
+	uint8_t* nextMip = scratch.data();
+	JobContext* job = GetCurrentJob();
+	for (int i = 0; i < mips; i++) {
+		if (IsJobCancelled(job)) {
+			return ENCODE_FAILED;
+		}
+
+		unsigned int levelSize = 0;
+		EncodeStatus status = EncodeSurfaceByMode(&surface, (uint8_t*)outBuf + size, outBufSize - size, mode, level, levelSize);
+		if (status != ENCODE_OK) {
+			return status;
+		}
+		size += levelSize;
+
+		if (i < mips - 1) {
+			int nextWidth = std::max(1, surface.width >> 1);
+			int nextHeight = std::max(1, surface.height >> 1);
+			DownsampleRGBA(surface.ptr, surface.width, surface.height, surface.stride, nextMip, nextWidth, nextHeight);
+
+			surface.ptr = nextMip;
+			surface.width = nextWidth;
+			surface.height = nextHeight;
+			surface.stride = nextWidth * 4;
+			nextMip += (size_t)nextWidth * nextHeight * 4;
+		}
+	}
+
+	return ENCODE_OK;
+}
+
+// encodes a list of rgba32 surfaces (usually a whole batch of textures, each
+// with its mip chain) in one call. returns the number of items that encoded
+// successfully, check each item's status for the rest. progress counts
+// finished items.
+EXPORT int EncodeBatch(EncodeBatchItem* items, int count, EncodeProgressFunc progress, void* progressData) {
+	std::atomic<int> successCount(0);
+	// not bound, the items are counted whole instead of by what's inside them
+	ProgressReporter reporter(progress, progressData, (unsigned int)std::max(0, count), false);
+
+	ParallelFor(count, [&](int i) {
+		EncodeBatchItem& item = items[i];
+
+		rgba_surface surface;
+		surface.ptr = (uint8_t*)item.data;
+		surface.width = item.width;
+		surface.height = item.height;
+		surface.stride = item.stride != 0 ? item.stride : item.width * 4;
+		if (item.flipY && item.height > 0) {
+			surface.ptr += (size_t)(item.height - 1) * surface.stride;
+			surface.stride = -surface.stride;
+		}
+
+		unsigned int size = 0;
+		EncodeStatus status = EncodeMipChain(surface, item.outBuf, item.outBufSize, item.mode, item.level, item.mips, size);
+		item.size = status == ENCODE_OK ? size : 0;
+		item.status = status;
+
+		if (status == ENCODE_OK) {
+			successCount++;
+		}
+		reporter.Advance(1);
+	});
+
+	return successCount;
+}
+
+// generates the mip chain from the base level and encodes every level
+// back to back into outBuf, the same layout unity uses for image data.
+// returns the total size written or 0 if any level failed. flipY reads the
+// base level bottom up, the generated mips come out the right way already.
+EXPORT unsigned int EncodeWithMips(void* data, void* outBuf, unsigned int outBufSize, int mode, int level, unsigned int width, unsigned int height, int mips, bool flipY,
+	EncodeProgressFunc progress, void* progressData) {
+	if (mips < 1) {
+		mips = 1;
+	}
+
+	unsigned int progressTotal = GetEncodeProgressUnits(mode, height);
+	unsigned int mipHeight = height;
+	for (int i = 1; i < mips; i++) {
+		mipHeight = std::max(1U, mipHeight >> 1);
+		progressTotal += GetEncodeProgressUnits(mode, mipHeight);
+	}
+
+	ProgressReporter reporter(progress, progressData, progressTotal);
+
+	unsigned int size = 0;
+	if (EncodeMipChain(MakeSurface(data, width, height, flipY), outBuf, outBufSize, mode, level, mips, size) != ENCODE_OK) {
+		return 0;
+	}
+	return size;
+}
+
+// state for an encode that gets its rows pushed in a band at a time, so the
+// whole rgba32 source never has to exist at once. rows come in top to bottom
+// and get grouped into block rows (for astc, the same chunks of them a whole
+// image encode uses), which are encoded as soon as they're whole. a group
+// that's split between two pushes waits in carry.
+struct StreamEncoder {
+	int mode;
+	int level;
+	unsigned int width;
+	unsigned int height;
+	bool flipY;
+	unsigned int blockHeight;
+	unsigned int groupHeight; // rows encoded together, a block row or an astc chunk
+	size_t blockRowByteSize;
+	unsigned int encodedSize;
+	unsigned int rowsPushed;
+	std::vector<uint8_t> carry;
+	unsigned int carryRows;
+	bool failed;
+};
+
+// source row where the group holding row ends. flipped images count groups
+// from the bottom, so there the ragged one is at the top instead.
+static unsigned int StreamGroupEnd(const StreamEncoder* encoder, unsigned int row) {
+	unsigned int first = encoder->flipY ? encoder->height % encoder->groupHeight : 0;
+	if (row < first) {
+		return first;
+	}
+	return std::min(encoder->height, first + ((row - first) / encoder->groupHeight + 1) * encoder->groupHeight);
+}
+
+// encodes the whole block rows in source rows start to end, which sit at rows
+static bool StreamEncodeRun(StreamEncoder* encoder, const uint8_t* rows, unsigned int start, unsigned int end, uint8_t* outBuf, unsigned int outBufSize) {
+	rgba_surface surface = MakeSurface((void*)rows, encoder->width, end - start, encoder->flipY);
+
+	unsigned int firstRow = encoder->flipY ? encoder->height - end : start;
+	size_t offset = (firstRow / encoder->blockHeight) * encoder->blockRowByteSize;
+
+	unsigned int size = 0;
+	return EncodeSurfaceByMode(&surface, outBuf + offset, (unsigned int)(outBufSize - offset), encoder->mode, encoder->level, size) == ENCODE_OK;
+}
+
+// only formats that encode a block row on its own work here, so the ispc
+// ones and the plain shuffles. returns null for anything else.
+EXPORT void* BeginStreamEncode(int mode, int level, unsigned int width, unsigned int height, bool flipY) {
+	int blockWidth = 1;
+	int blockHeight = 1;
+	int blockByteSize = GetConvertPixelSize(mode);
+	if (blockByteSize == 0 && !GetISPCBlockInfo(mode, blockWidth, blockHeight, blockByteSize)) {
+		return nullptr;
+	}
+	if (width == 0 || height == 0) {
+		return nullptr;
+	}
+
+	StreamEncoder* encoder = new StreamEncoder();
+	encoder->mode = mode;
+	encoder->level = level;
+	encoder->width = width;
+	encoder->height = height;
+	encoder->flipY = flipY;
+	encoder->blockHeight = blockHeight;
+	encoder->groupHeight = blockHeight;
+	if ((mode >= 48 && mode <= 51) || (mode >= 54 && mode <= 57)) {
+		// astc has to be cut where a whole image encode would cut it
+		int blockCountX = (width + blockWidth - 1) / blockWidth;
+		encoder->groupHeight = blockHeight * GetStripChunkRows(blockCountX);
+	}
+	encoder->blockRowByteSize = (size_t)((width + blockWidth - 1) / blockWidth) * blockByteSize;
+	encoder->encodedSize = GetTextureByteSize(mode, width, height);
+	encoder->rowsPushed = 0;
+	encoder->carry.resize((size_t)encoder->groupHeight * width * 4);
+	encoder->carryRows = 0;
+	encoder->failed = false;
+	return encoder;
+}
+
+// rows is rowCount tightly packed rgba32 rows, continuing where the last push
+// stopped. finished block rows go straight to their place in outBuf, which
+// has to be the whole encoded image. any band size works, bigger bands just
+// give the thread pool more to split up.
+EXPORT bool StreamEncodeRows(void* handle, void* rows, unsigned int rowCount, void* outBuf, unsigned int outBufSize) {
+	StreamEncoder* encoder = (StreamEncoder*)handle;
+	if (encoder->failed || outBufSize < encoder->encodedSize || rowCount > encoder->height - encoder->rowsPushed) {
+		encoder->failed = true;
+		return false;
+	}
+
+	const uint8_t* src = (const uint8_t*)rows;
+	size_t rowByteSize = (size_t)encoder->width * 4;
+
+	// finish off the block row that was left hanging last time
+	if (encoder->carryRows > 0 && rowCount > 0) {
+		unsigned int groupStart = encoder->rowsPushed - encoder->carryRows;
+		unsigned int groupEnd = StreamGroupEnd(encoder, groupStart);
+		unsigned int take = std::min(rowCount, groupEnd - encoder->rowsPushed);
+
+		memcpy(encoder->carry.data() + encoder->carryRows * rowByteSize, src, take * rowByteSize);
+		encoder->carryRows += take;
+		encoder->rowsPushed += take;
+		src += take * rowByteSize;
+		rowCount -= take;
+
+		if (encoder->rowsPushed == groupEnd) {
+			if (!StreamEncodeRun(encoder, encoder->carry.data(), groupStart, groupEnd, (uint8_t*)outBuf, outBufSize)) {
+				encoder->failed = true;
+				return false;
+			}
+			encoder->carryRows = 0;
+		}
+	}
+
+	// every whole block row left is encoded right out of the caller's rows
+	unsigned int runStart = encoder->rowsPushed;
+	unsigned int runEnd = runStart;
+	while (runEnd < encoder->height && StreamGroupEnd(encoder, runEnd) <= runStart + rowCount) {
+		runEnd = StreamGroupEnd(encoder, runEnd);
+	}
+	if (runEnd > runStart) {
+		if (!StreamEncodeRun(encoder, src, runStart, runEnd, (uint8_t*)outBuf, outBufSize)) {
+			encoder->failed = true;
+			return false;
+		}
+		src += (runEnd - runStart) * rowByteSize;
+		rowCount -= runEnd - runStart;
+		encoder->rowsPushed = runEnd;
+	}
+
+	// and the start of the next one waits for more rows
+	if (rowCount > 0) {
+		memcpy(encoder->carry.data(), src, rowCount * rowByteSize);
+		encoder->carryRows = rowCount;
+		encoder->rowsPushed += rowCount;
+	}
+
+	return true;
+}
+
+// frees the encoder. returns the encoded size, or 0 if a push failed or
+// not every row was pushed.
+EXPORT unsigned int EndStreamEncode(void* handle) {
+	StreamEncoder* encoder = (StreamEncoder*)handle;
+	unsigned int size = 0;
+	if (!encoder->failed && encoder->rowsPushed == encoder->height) {
+		size = encoder->encodedSize;
+	}
+	delete encoder;
+	return size;
+}
+
+// count <= 0 uses every hardware thread
+EXPORT void SetThreadCount(int count) {
+	SetPoolThreadCount(count);
+}
+
+EXPORT int GetThreadCount() {
+	return GetPoolThreadCount();
+}
+
 EXPORT unsigned int DecodeByCrunchUnity(void* data, void* outBuf, int mode, unsigned int width, unsigned int height, unsigned int byteSize) {
 	crnd::crn_texture_info tex_info;
 	tex_info.m_struct_size = sizeof(crnd::crn_texture_info);
@@ -243,9 +1020,686 @@ EXPORT unsigned int DecodeByCrunchUnity(void* data, void* outBuf, int mode, unsi
 	}
 }
 
+// converts between rgba32 (4), bgra32 (14), argb32 (5) and rgb24 (3), or
+// pulls the alpha out into alpha8 (1). src and dst can be the same buffer
+// if the pixel sizes match and flipY is off. returns the bytes written to dst or 0.
+EXPORT unsigned int ConvertPixels(void* src, void* dst, int srcMode, int dstMode, unsigned int width, unsigned int height, bool flipY) {
+	int srcPixelSize = GetConvertPixelSize(srcMode);
+	if (srcPixelSize == 0) {
+		return 0;
+	}
+
+	const uint8_t* srcRows = (const uint8_t*)src;
+	ptrdiff_t srcStride = (ptrdiff_t)width * srcPixelSize;
+	if (flipY && height > 0) {
+		srcRows += (height - 1) * srcStride;
+		srcStride = -srcStride;
+	}
+
+	if (!ConvertPixelRows(srcRows, srcMode, srcStride, (uint8_t*)dst, dstMode, width, height)) {
+		return 0;
+	}
+
+	return width * height * GetConvertPixelSize(dstMode);
+}
+
+// bc1-bc7 to an uncompressed format without going through pvrtexlib.
+// outMode is rgba32 (4), bgra32 (14), argb32 (5) or rgbahalf (17, bc6h only).
+// outBuf has to fit exactly width * height pixels of outMode.
+EXPORT unsigned int DecodeBCn(void* data, void* outBuf, int mode, int outMode, unsigned int width, unsigned int height, bool flipY) {
+	int pixelSize = GetBCDecodePixelSize(outMode);
+	if (pixelSize == 0) {
+		return 0;
+	}
+
+	if (!DecodeBCSurface(mode, outMode, (const uint8_t*)data, width, height, (uint8_t*)outBuf, flipY)) {
+		return 0;
+	}
+
+	return width * height * pixelSize;
+}
+
+// block size of the formats switch textures come in, uncompressed ones
+// are 1x1 blocks of one pixel
+static bool GetSwitchBlockInfo(int mode, int& blockWidth, int& blockHeight, int& blockByteSize) {
+	blockWidth = 1;
+	blockHeight = 1;
+	switch (mode) {
+		case 1:  //Alpha8
+		case 63: //R8
+			blockByteSize = 1;
+			return true;
+		case 2:  //ARGB4444
+		case 13: //RGBA4444
+		case 7:  //RGB565
+		case 9:  //R16
+		case 62: //RG16
+			blockByteSize = 2;
+			return true;
+		case 4:  //RGBA32
+		case 5:  //ARGB32
+		case 14: //BGRA32
+			blockByteSize = 4;
+			return true;
+		case 10: //DXT1
+		case 26: //BC4
+			blockWidth = blockHeight = 4;
+			blockByteSize = 8;
+			return true;
+		case 12: //DXT5
+		case 24: //BC6H
+		case 25: //BC7
+		case 27: //BC5
+		case 48: case 54: //ASTC 4x4
+			blockWidth = blockHeight = 4;
+			blockByteSize = 16;
+			return true;
+		case 49: case 55: blockWidth = blockHeight = 5; blockByteSize = 16; return true;   //ASTC 5x5
+		case 50: case 56: blockWidth = blockHeight = 6; blockByteSize = 16; return true;   //ASTC 6x6
+		case 51: case 57: blockWidth = blockHeight = 8; blockByteSize = 16; return true;   //ASTC 8x8
+		case 52: case 58: blockWidth = blockHeight = 10; blockByteSize = 16; return true;  //ASTC 10x10
+		case 53: case 59: blockWidth = blockHeight = 12; blockByteSize = 16; return true;  //ASTC 12x12
+		default:
+			return false;
+	}
+}
+
+static unsigned int SwizzleSwitch(void* data, unsigned int dataSize, void* outBuf, unsigned int outBufSize,
+	int mode, unsigned int width, unsigned int height, int gobsPerBlock, int mips, bool unswizzle) {
+	SwitchSurfaceInfo info;
+	if (!GetSwitchBlockInfo(mode, info.blockWidth, info.blockHeight, info.blockByteSize)) {
+		return 0;
+	}
+	info.width = width;
+	info.height = height;
+	info.gobsPerBlock = gobsPerBlock;
+	info.mips = mips;
+
+	size_t linearSize;
+	size_t swizzledSize;
+	GetSwitchMipsSizes(info, linearSize, swizzledSize);
+
+	size_t srcSize = unswizzle ? swizzledSize : linearSize;
+	size_t dstSize = unswizzle ? linearSize : swizzledSize;
+	if (dstSize > UINT_MAX) {
+		return 0;
+	}
+	if (outBuf == NULL) {
+		return (unsigned int)dstSize;
+	}
+	if (dataSize < srcSize || outBufSize < dstSize) {
+		return 0;
+	}
+
+	SwizzleSwitchMips(info, (const uint8_t*)data, (uint8_t*)outBuf, unswizzle);
+	return (unsigned int)dstSize;
+}
+
+// switch texture data to and from plain block rows without decoding it.
+// data is every mip back to back like unity stores them, the swizzled side
+// has each level padded out to whole gob blocks. pass a null outBuf to get
+// the size needed. returns the bytes written or 0.
+EXPORT unsigned int SwizzleSwitchBlocks(void* data, unsigned int dataSize, void* outBuf, unsigned int outBufSize, int mode, unsigned int width, unsigned int height, int gobsPerBlock, int mips) {
+	return SwizzleSwitch(data, dataSize, outBuf, outBufSize, mode, width, height, gobsPerBlock, mips, false);
+}
+
+EXPORT unsigned int UnswizzleSwitchBlocks(void* data, unsigned int dataSize, void* outBuf, unsigned int outBufSize, int mode, unsigned int width, unsigned int height, int gobsPerBlock, int mips) {
+	return SwizzleSwitch(data, dataSize, outBuf, outBufSize, mode, width, height, gobsPerBlock, mips, true);
+}
+
+// unpacks one level of a crunched dxt1/dxt5 texture to plain blocks. bcMode
+// gets the mode the blocks are in. etc is left to the crunch unity decoder.
+static bool UnpackCrunchLevel(void* data, unsigned int byteSize, const crnd::crn_texture_info& tex_info, crnd::uint level, std::vector<uint8_t>& blocks, int& bcMode) {
+	switch (tex_info.m_format) {
+		case cCRNFmtDXT1: bcMode = 10; break;
+		case cCRNFmtDXT5: bcMode = 12; break;
+		default: return false;
+	}
+
+	if (level >= tex_info.m_levels) {
+		return false;
+	}
+
+	const crnd::uint level_width = crnd::math::maximum<crnd::uint>(1U, tex_info.m_width >> level);
+	const crnd::uint level_height = crnd::math::maximum<crnd::uint>(1U, tex_info.m_height >> level);
+	const crnd::uint num_blocks_x = (level_width + 3U) >> 2U;
+	const crnd::uint num_blocks_y = (level_height + 3U) >> 2U;
+	const crnd::uint row_pitch = num_blocks_x * tex_info.m_bytes_per_block;
+	const crnd::uint size_of_face = num_blocks_y * row_pitch;
+
+	crnd::crnd_unpack_context pContext = crnd::crnd_unpack_begin(data, byteSize);
+	if (!pContext) {
+		return false;
+	}
+
+	blocks.resize(size_of_face);
+	void* blocksPtr = blocks.data();
+	bool success = crnd::crnd_unpack_level(pContext, &blocksPtr, size_of_face, row_pitch, level);
+	crnd::crnd_unpack_end(pContext);
+	return success;
+}
+
+// crunched dxt1/dxt5 straight to rgba32, so the blocks never have to make a
+// trip through the managed side. outBuf has to fit width * height * 4 bytes.
+EXPORT unsigned int DecodeCrunchToRGBA(void* data, void* outBuf, unsigned int width, unsigned int height, unsigned int byteSize, bool flipY) {
+	crnd::crn_texture_info tex_info;
+	tex_info.m_struct_size = sizeof(crnd::crn_texture_info);
+	if (!crnd_get_texture_info(data, byteSize, &tex_info)) {
+		return 0;
+	}
+
+	if (tex_info.m_width != width || tex_info.m_height != height) {
+		return 0;
+	}
+
+	std::vector<uint8_t> blocks;
+	int bcMode;
+	if (!UnpackCrunchLevel(data, byteSize, tex_info, 0, blocks, bcMode)) {
+		return 0;
+	}
+
+	// etc crunch variants unpack fine but aren't something DecodeBCSurface takes
+	if (!DecodeBCSurface(bcMode, 4, blocks.data(), width, height, (uint8_t*)outBuf, flipY)) {
+		return 0;
+	}
+	return width * height * 4;
+}
+
+// whether DecodeToRGBA has a decoder for mode at all
+static bool CanDecodeToRGBA(int mode) {
+	switch (mode) {
+		case 28: //DXT1Crunched
+		case 29: //DXT5Crunched
+		case 64: //ETC_RGB4Crunched
+		case 65: //ETC2_RGBA8Crunched
+		case 5:  //ARGB32
+		case 14: //BGRA32
+		case 4:  //RGBA32
+		case 3:  //RGB24
+		case 10: //DXT1
+		case 12: //DXT5
+		case 24: //BC6H
+		case 25: //BC7
+		case 26: //BC4
+		case 27: //BC5
+			return true;
+		default:
+		{
+			PVRTuint64 pvrtlMode;
+			PVRTexLibVariableType pvrtlVarType;
+			return GetPVRTexLibModes(mode, pvrtlMode, pvrtlVarType);
+		}
+	}
+}
+
+// picks the same decoder the plugin would and decodes to rgba32. formats that
+// are only decoded on the managed side end up at pvrtexlib, which rejects them.
+static unsigned int DecodeToRGBA(const uint8_t* data, unsigned int dataSize, void* outBuf, int mode, unsigned int width, unsigned int height, bool flipY) {
+	switch (mode) {
+		case 28: //DXT1Crunched
+		case 29: //DXT5Crunched
+			return DecodeCrunchToRGBA((void*)data, outBuf, width, height, dataSize, flipY);
+		case 64: //ETC_RGB4Crunched
+		case 65: //ETC2_RGBA8Crunched
+		{
+			int etcMode = mode == 64 ? 34 : 47;
+			std::vector<uint8_t> blocks(GetTextureByteSize(etcMode, width, height));
+			if (DecodeByCrunchUnity((void*)data, blocks.data(), mode, width, height, dataSize) == 0) {
+				return 0;
+			}
+			return DecodeByPVRTexLib(blocks.data(), outBuf, etcMode, width, height, flipY);
+		}
+		default:
+			break;
+	}
+
+	// everything else reads exactly one level, so make sure it's all there
+	if (dataSize < GetTextureByteSize(mode, width, height)) {
+		return 0;
+	}
+
+	switch (mode) {
+		case 5:  //ARGB32
+		case 14: //BGRA32
+		case 4:  //RGBA32
+		case 3:  //RGB24
+			return ConvertPixels((void*)data, outBuf, mode, 4, width, height, flipY);
+		case 10: //DXT1
+		case 12: //DXT5
+		case 24: //BC6H
+		case 25: //BC7
+		case 26: //BC4
+		case 27: //BC5
+			return DecodeBCn((void*)data, outBuf, mode, 4, width, height, flipY);
+		default:
+			return DecodeByPVRTexLib((void*)data, outBuf, mode, width, height, flipY);
+	}
+}
+
+// DecodeToRGBA, but textures decoded a moment ago just get copied out of the
+// decode cache. the key is a hash of the encoded bytes, so edited data misses.
+static unsigned int DecodeToRGBACached(const uint8_t* data, unsigned int dataSize, void* outBuf, int mode, unsigned int width, unsigned int height, bool flipY) {
+	// no point hashing (or counting a miss) for something that can't decode
+	if (!CanDecodeToRGBA(mode)) {
+		return 0;
+	}
+
+	DecodeCacheKey key;
+	key.hash = HashBytes(data, dataSize, 0);
+	key.dataSize = dataSize;
+	key.mode = mode;
+	key.width = width;
+	key.height = height;
+	key.flipY = flipY;
+
+	size_t outSize = (size_t)width * height * 4;
+	if (DecodeCacheLookup(key, outBuf, outSize)) {
+		return (unsigned int)outSize;
+	}
+
+	unsigned int size = DecodeToRGBA(data, dataSize, outBuf, mode, width, height, flipY);
+	if (size == outSize) {
+		DecodeCacheInsert(key, outBuf, size);
+	}
+	return size;
+}
+
+// decodes any format the native side knows to rgba32 (outBuf is width *
+// height * 4), going through the decode cache. returns 0 for formats that
+// have to be decoded on the managed side.
+EXPORT unsigned int DecodeCached(void* data, unsigned int dataSize, void* outBuf, int mode, unsigned int width, unsigned int height, bool flipY) {
+	return DecodeToRGBACached((const uint8_t*)data, dataSize, outBuf, mode, width, height, flipY);
+}
+
+// bytes of decoded pixels the cache can hold, 0 turns it off
+EXPORT void SetDecodeCacheBudget(unsigned long long bytes) {
+	DecodeCacheSetBudget((size_t)bytes);
+}
+
+EXPORT void ClearDecodeCache() {
+	DecodeCacheClear();
+}
+
+EXPORT void GetDecodeCacheStats(unsigned long long* hits, unsigned long long* misses, unsigned long long* usedBytes, unsigned long long* entryCount) {
+	uint64_t statHits, statMisses, statUsed, statEntries;
+	DecodeCacheGetStats(statHits, statMisses, statUsed, statEntries);
+	*hits = statHits;
+	*misses = statMisses;
+	*usedBytes = statUsed;
+	*entryCount = statEntries;
+}
+
+// decodes size bytes at offset in the file at path (utf-8) to rgba32 without
+// reading them in first. the region is mapped read only, so only the pages the
+// decoder actually touches come off the disk. meant for streamed textures in
+// big .resS files. this skips the decode cache on purpose: hashing the region
+// would fault in every page of it, and batch exports would just churn the
+// cache. returns the decoded size, 0 if the file couldn't be mapped or the
+// format isn't one the native side decodes.
+EXPORT unsigned int DecodeFileRegion(const char* path, unsigned long long offset, unsigned int size, void* outBuf, int mode, unsigned int width, unsigned int height, bool flipY) {
+	MappedFileRegion region;
+	if (!MapFileRegion(path, offset, size, region)) {
+		return 0;
+	}
+
+	unsigned int decodedSize = DecodeToRGBA(region.data, size, outBuf, mode, width, height, flipY);
+	UnmapFileRegion(region);
+	return decodedSize;
+}
+
+static bool IsBCMode(int mode) {
+	switch (mode) {
+		case 10: //DXT1
+		case 12: //DXT5
+		case 24: //BC6H
+		case 25: //BC7
+		case 26: //BC4
+		case 27: //BC5
+			return true;
+		default:
+			return false;
+	}
+}
+
+// which level a preview comes from and how it gets shrunk further
+struct PreviewPlan {
+	unsigned int level;
+	unsigned int levelWidth;
+	unsigned int levelHeight;
+	unsigned int blockStep; // 0 decodes the level as is
+	unsigned int width;
+	unsigned int height;
+};
+
+// walks down from mip 0 while the next level still has a side of at least
+// previewSize. a bcn level that's still 4x bigger than that skips blocks too.
+static void PlanPreview(int mode, unsigned int width, unsigned int height, unsigned int levelCount, unsigned int previewSize, PreviewPlan& plan) {
+	plan.level = 0;
+	plan.levelWidth = width;
+	plan.levelHeight = height;
+	for (unsigned int level = 1; level < levelCount; level++) {
+		unsigned int nextWidth = std::max(1U, width >> level);
+		unsigned int nextHeight = std::max(1U, height >> level);
+		if (std::max(nextWidth, nextHeight) < previewSize) {
+			break;
+		}
+		plan.level = level;
+		plan.levelWidth = nextWidth;
+		plan.levelHeight = nextHeight;
+	}
+
+	plan.blockStep = 0;
+	plan.width = plan.levelWidth;
+	plan.height = plan.levelHeight;
+	if (IsBCMode(mode) && previewSize > 0) {
+		unsigned int blockCount = std::max((plan.levelWidth + 3) >> 2, (plan.levelHeight + 3) >> 2);
+		if (blockCount >= previewSize) {
+			plan.blockStep = blockCount / previewSize;
+			GetBCPreviewSize(plan.levelWidth, plan.levelHeight, plan.blockStep, plan.width, plan.height);
+		}
+	}
+}
+
+static unsigned int DecodePreviewLevel(const uint8_t* data, unsigned int dataSize, void* outBuf, int mode, const PreviewPlan& plan, bool flipY) {
+	if (plan.blockStep == 0) {
+		return DecodeToRGBA(data, dataSize, outBuf, mode, plan.levelWidth, plan.levelHeight, flipY);
+	}
+
+	if (dataSize < GetTextureByteSize(mode, plan.levelWidth, plan.levelHeight)) {
+		return 0;
+	}
+	if (!DecodeBCPreview(mode, 4, data, plan.levelWidth, plan.levelHeight, plan.blockStep, (uint8_t*)outBuf, flipY)) {
+		return 0;
+	}
+	return plan.width * plan.height * 4;
+}
+
+// decodes a thumbnail of about previewSize pixels on its longer side to rgba32.
+// it comes from the smallest stored mip that's still at least that big, and
+// bcn levels much bigger than that only get every few blocks decoded, each
+// one down to a single averaged pixel. so the result is anywhere between
+// previewSize and about 4x that, never smaller unless the texture is.
+// previewWidth/previewHeight get the size. with a null outBuf nothing is
+// decoded and it just returns the bytes needed. returns 0 on failure or if
+// outBufSize is too small.
+EXPORT unsigned int DecodePreview(void* data, unsigned int dataSize, void* outBuf, unsigned int outBufSize, int mode, unsigned int width, unsigned int height,
+	int mipCount, unsigned int previewSize, bool flipY, unsigned int* previewWidth, unsigned int* previewHeight) {
+	PreviewPlan plan;
+	std::vector<uint8_t> crunchBlocks;
+	const uint8_t* levelData = (const uint8_t*)data;
+	unsigned int levelDataSize = dataSize;
+
+	if (mode == 28 || mode == 29) {
+		// crunch keeps its own mips, so unpack just the level that's needed
+		crnd::crn_texture_info tex_info;
+		tex_info.m_struct_size = sizeof(crnd::crn_texture_info);
+		if (!crnd_get_texture_info(data, dataSize, &tex_info) || tex_info.m_width != width || tex_info.m_height != height) {
+			return 0;
+		}
+
+		int bcMode;
+		PlanPreview(mode == 28 ? 10 : 12, width, height, tex_info.m_levels, previewSize, plan);
+		if (outBuf != nullptr) {
+			if (!UnpackCrunchLevel(data, dataSize, tex_info, plan.level, crunchBlocks, bcMode)) {
+				return 0;
+			}
+			mode = bcMode;
+			levelData = crunchBlocks.data();
+			levelDataSize = (unsigned int)crunchBlocks.size();
+		}
+	} else if (mode == 64 || mode == 65) {
+		// etc crunch only unpacks the whole thing
+		PlanPreview(mode, width, height, 1, previewSize, plan);
+	} else {
+		PlanPreview(mode, width, height, std::max(1, mipCount), previewSize, plan);
+
+		size_t offset = 0;
+		for (unsigned int level = 0; level < plan.level; level++) {
+			offset += GetTextureByteSize(mode, std::max(1U, width >> level), std::max(1U, height >> level));
+		}
+		if (offset >= dataSize) {
+			return 0;
+		}
+		levelData += offset;
+		levelDataSize -= (unsigned int)offset;
+	}
+
+	*previewWidth = plan.width;
+	*previewHeight = plan.height;
+	unsigned int previewBytes = plan.width * plan.height * 4;
+	if (outBuf == nullptr) {
+		return previewBytes;
+	}
+	if (outBufSize < previewBytes) {
+		return 0;
+	}
+
+	return DecodePreviewLevel(levelData, levelDataSize, outBuf, mode, plan, flipY);
+}
+
+// size of the smallest piece of a format that decodes on its own. pvrtc
+// blends neighboring blocks and crunch is one big stream, so those aren't
+// here. the bytes per block come from GetTextureByteSize of one block.
+static bool GetBlockDimensions(int mode, unsigned int& blockWidth, unsigned int& blockHeight) {
+	switch (mode) {
+		case 10: case 12: case 24: case 25: case 26: case 27: //BCn
+		case 34: case 60: case 45: case 46: case 47: case 61: //ETC
+		case 41: case 42: case 43: case 44:                   //EAC
+		case 48: case 54: blockWidth = 4; blockHeight = 4; return true;
+		case 49: case 55: blockWidth = 5; blockHeight = 5; return true;
+		case 50: case 56: blockWidth = 6; blockHeight = 6; return true;
+		case 51: case 57: blockWidth = 8; blockHeight = 8; return true;
+		case 52: case 58: blockWidth = 10; blockHeight = 10; return true;
+		case 53: case 59: blockWidth = 12; blockHeight = 12; return true;
+		case 21: blockWidth = 2; blockHeight = 1; return true; //YUY2 shares chroma across pairs
+		case 1: case 2: case 3: case 4: case 5: case 7: case 9: case 13: case 14:
+		case 15: case 16: case 17: case 18: case 19: case 20: case 22: case 62: case 63:
+			blockWidth = 1; blockHeight = 1; return true;
+		default:
+			return false;
+	}
+}
+
+static void CopyPixelRect(const uint8_t* src, unsigned int srcWidth, unsigned int x, unsigned int y, uint8_t* dst, unsigned int width, unsigned int height) {
+	for (unsigned int row = 0; row < height; row++) {
+		memcpy(dst + (size_t)row * width * 4, src + ((size_t)(y + row) * srcWidth + x) * 4, (size_t)width * 4);
+	}
+}
+
+// decodes just the rectangle at x, y of size regionWidth * regionHeight to
+// rgba32. the rectangle is in the decoded image, so with flipY it counts from
+// the top like the rows come out. only the blocks touching it get copied into
+// a small surface and decoded. pvrtc and anything unknown decode in full and
+// get cropped. crunch still has to unpack all of its blocks, but only the
+// ones in the rectangle get decoded from there. returns 0 on failure.
+EXPORT unsigned int DecodeRegion(void* data, unsigned int dataSize, void* outBuf, int mode, unsigned int width, unsigned int height,
+	unsigned int x, unsigned int y, unsigned int regionWidth, unsigned int regionHeight, bool flipY) {
+	if (regionWidth == 0 || regionHeight == 0 || x > width || y > height || regionWidth > width - x || regionHeight > height - y) {
+		return 0;
+	}
+
+	const uint8_t* src = (const uint8_t*)data;
+	std::vector<uint8_t> unpacked;
+	if (mode == 28 || mode == 29) {
+		crnd::crn_texture_info tex_info;
+		tex_info.m_struct_size = sizeof(crnd::crn_texture_info);
+		if (!crnd_get_texture_info(data, dataSize, &tex_info) || tex_info.m_width != width || tex_info.m_height != height) {
+			return 0;
+		}
+
+		int bcMode;
+		if (!UnpackCrunchLevel(data, dataSize, tex_info, 0, unpacked, bcMode)) {
+			return 0;
+		}
+		mode = bcMode;
+	} else if (mode == 64 || mode == 65) {
+		int etcMode = mode == 64 ? 34 : 47;
+		unpacked.resize(GetTextureByteSize(etcMode, width, height));
+		if (DecodeByCrunchUnity(data, unpacked.data(), mode, width, height, dataSize) == 0) {
+			return 0;
+		}
+		mode = etcMode;
+	}
+
+	if (!unpacked.empty()) {
+		src = unpacked.data();
+		dataSize = (unsigned int)unpacked.size();
+	}
+
+	unsigned int regionSize = regionWidth * regionHeight * 4;
+	unsigned int blockWidth, blockHeight;
+	if (!GetBlockDimensions(mode, blockWidth, blockHeight)) {
+		std::vector<uint8_t> full((size_t)width * height * 4);
+		if (DecodeToRGBA(src, dataSize, full.data(), mode, width, height, flipY) != full.size()) {
+			return 0;
+		}
+		CopyPixelRect(full.data(), width, x, y, (uint8_t*)outBuf, regionWidth, regionHeight);
+		return regionSize;
+	}
+
+	if (dataSize < GetTextureByteSize(mode, width, height)) {
+		return 0;
+	}
+
+	// rows of the stored data the rectangle covers
+	unsigned int storedY = flipY ? height - y - regionHeight : y;
+	unsigned int blockX0 = x / blockWidth;
+	unsigned int blockY0 = storedY / blockHeight;
+	unsigned int blockX1 = (x + regionWidth + blockWidth - 1) / blockWidth;
+	unsigned int blockY1 = (storedY + regionHeight + blockHeight - 1) / blockHeight;
+	unsigned int blockCountX = (width + blockWidth - 1) / blockWidth;
+	unsigned int blockByteSize = GetTextureByteSize(mode, blockWidth, blockHeight);
+
+	// the last block column or row might hang off the image, same as in the full texture
+	unsigned int subWidth = std::min(width, blockX1 * blockWidth) - blockX0 * blockWidth;
+	unsigned int subHeight = std::min(height, blockY1 * blockHeight) - blockY0 * blockHeight;
+	size_t subRowSize = (size_t)(blockX1 - blockX0) * blockByteSize;
+
+	std::vector<uint8_t> subBlocks(subRowSize * (blockY1 - blockY0));
+	for (unsigned int by = blockY0; by < blockY1; by++) {
+		memcpy(subBlocks.data() + (by - blockY0) * subRowSize, src + ((size_t)by * blockCountX + blockX0) * blockByteSize, subRowSize);
+	}
+
+	unsigned int offsetX = x - blockX0 * blockWidth;
+	unsigned int offsetY = flipY ? blockY0 * blockHeight + subHeight - (storedY + regionHeight) : storedY - blockY0 * blockHeight;
+	if (offsetX == 0 && offsetY == 0 && subWidth == regionWidth && subHeight == regionHeight) {
+		return DecodeToRGBA(subBlocks.data(), (unsigned int)subBlocks.size(), outBuf, mode, subWidth, subHeight, flipY) == regionSize ? regionSize : 0;
+	}
+
+	std::vector<uint8_t> sub((size_t)subWidth * subHeight * 4);
+	if (DecodeToRGBA(subBlocks.data(), (unsigned int)subBlocks.size(), sub.data(), mode, subWidth, subHeight, flipY) != sub.size()) {
+		return 0;
+	}
+	CopyPixelRect(sub.data(), subWidth, offsetX, offsetY, (uint8_t*)outBuf, regionWidth, regionHeight);
+	return regionSize;
+}
+
+static crnd::uint GetCrunchLevelSize(const crnd::crn_texture_info& tex_info, crnd::uint level) {
+	const crnd::uint level_width = crnd::math::maximum<crnd::uint>(1U, tex_info.m_width >> level);
+	const crnd::uint level_height = crnd::math::maximum<crnd::uint>(1U, tex_info.m_height >> level);
+	const crnd::uint num_blocks_x = (level_width + 3U) >> 2U;
+	const crnd::uint num_blocks_y = (level_height + 3U) >> 2U;
+	return num_blocks_x * num_blocks_y * tex_info.m_bytes_per_block;
+}
+
+// unpacks every level of every face into outBuf the way unity stores it:
+// face 0 with all of its mips, then face 1, and so on. pass a null outBuf
+// to get the size needed. returns 0 on failure.
+EXPORT unsigned int DecodeAllByCrunchUnity(void* data, unsigned int byteSize, void* outBuf, unsigned int outBufSize) {
+	crnd::crn_texture_info tex_info;
+	tex_info.m_struct_size = sizeof(crnd::crn_texture_info);
+	if (!crnd_get_texture_info(data, byteSize, &tex_info)) {
+		return 0;
+	}
+
+	if (tex_info.m_faces < 1 || tex_info.m_faces > cCRNMaxFaces) {
+		return 0;
+	}
+
+	unsigned int faceChainSize = 0;
+	for (crnd::uint level = 0; level < tex_info.m_levels; level++) {
+		faceChainSize += GetCrunchLevelSize(tex_info, level);
+	}
+	unsigned int totalSize = faceChainSize * tex_info.m_faces;
+
+	if (outBuf == NULL) {
+		return totalSize;
+	}
+	if (outBufSize < totalSize) {
+		return 0;
+	}
+
+	// one context for everything so the palettes and huffman tables
+	// are only decoded once instead of once per level
+	crnd::crnd_unpack_context pContext = crnd::crnd_unpack_begin(data, byteSize);
+	if (!pContext) {
+		return 0;
+	}
+
+	bool success = true;
+	unsigned int levelOffset = 0;
+	for (crnd::uint level = 0; level < tex_info.m_levels && success; level++) {
+		const crnd::uint levelSize = GetCrunchLevelSize(tex_info, level);
+
+		void* faceBufs[cCRNMaxFaces];
+		for (crnd::uint face = 0; face < tex_info.m_faces; face++) {
+			faceBufs[face] = (uint8_t*)outBuf + (size_t)face * faceChainSize + levelOffset;
+		}
+
+		success = crnd::crnd_unpack_level(pContext, faceBufs, levelSize, 0, level);
+		levelOffset += levelSize;
+	}
+
+	crnd::crnd_unpack_end(pContext);
+
+	if (success) {
+		return totalSize;
+	} else {
+		return 0;
+	}
+}
+
+struct CrunchProgressState {
+	JobContext* job;
+	ProgressReporter* reporter;
+};
+
+// crunch calls this between phases and gives up when it returns false.
+// every phase counts as 100 units so the subphases fit in between.
+static crn_bool CrunchProgress(crn_uint32 phase_index, crn_uint32 total_phases, crn_uint32 subphase_index, crn_uint32 total_subphases, void* pUser_data_ptr) {
+	CrunchProgressState* state = (CrunchProgressState*)pUser_data_ptr;
+	if (state->reporter != nullptr && total_phases > 0) {
+		unsigned int subphase = total_subphases > 0 ? subphase_index * 100 / total_subphases : 0;
+		state->reporter->Set(phase_index * 100 + subphase, total_phases * 100);
+	}
+	return !IsJobCancelled(state->job);
+}
+
+// helper threads crunch gets on top of the calling thread. < 0 uses the rest
+// of the thread pool's count (every hardware thread unless SetThreadCount
+// said otherwise), and it's capped to what crnlib takes.
+static crn_uint32 GetCrunchHelperThreadCount(int helperThreads) {
+	if (helperThreads < 0) {
+		helperThreads = GetPoolThreadCount() - 1;
+	}
+	return (crn_uint32)std::min(std::max(helperThreads, 0), (int)cCRNMaxHelperThreads);
+}
+
+// optional size/quality control for EncodeByCrunchUnity. leave both knobs
+// unset (qualityLevel < 0, targetBitrate <= 0) to go by level like before.
+struct CrunchEncodeSettings {
+	int qualityLevel; // crunch's own 0-255, used instead of level when >= 0
+	float targetBitrate; // bits per texel, > 0 lets crunch search for the quality that fits
+	// filled in after a successful encode
+	unsigned int actualQualityLevel;
+	float actualBitrate;
+	float encodeTimeMs;
+};
+
 // todo: we need to use two different versions of crunch: the original and the unity fork.
 // currently we just use the unity fork. need to look into when and where to use the original one.
-EXPORT unsigned int EncodeByCrunchUnity(void* data, int* checkoutId, int mode, int level, unsigned int width, unsigned int height, unsigned int ver, int mips) {
+EXPORT unsigned int EncodeByCrunchUnity(void* data, int* checkoutId, int mode, int level, unsigned int width, unsigned int height, unsigned int ver, int mips, bool flipY,
+	int helperThreads, CrunchEncodeSettings* settings, EncodeProgressFunc progress, void* progressData) {
 	crn_comp_params comp_params;
 	comp_params.m_width = width;
 	comp_params.m_height = height;
@@ -271,11 +1725,42 @@ EXPORT unsigned int EncodeByCrunchUnity(void* data, int* checkoutId, int mode, i
 			return 0;
 	}
 
-	comp_params.m_pImages[0][0] = (crn_uint32*)data;
-	comp_params.m_quality_level = 128; //cDefaultCRNQualityLevel
+	// crunch has no stride to play with, so flipping needs its own copy
+	std::vector<crn_uint32> flipped;
+	if (flipY) {
+		flipped.resize((size_t)width * height);
+		for (unsigned int y = 0; y < height; y++) {
+			memcpy(&flipped[(size_t)y * width], (crn_uint32*)data + (size_t)(height - 1 - y) * width, (size_t)width * 4);
+		}
+		comp_params.m_pImages[0][0] = flipped.data();
+	} else {
+		comp_params.m_pImages[0][0] = (crn_uint32*)data;
+	}
+	// m_dxt_quality only matters for .dds output, so this is the only knob.
+	// lower levels build smaller codebooks, which is faster and smaller too.
+	static const crn_uint32 crunchQualityLevels[QUALITY_LEVEL_COUNT] = { 64, 96, 128, 192, 255 };
+	comp_params.m_quality_level = crunchQualityLevels[ClampQualityLevel(level)]; //normal is cDefaultCRNQualityLevel
+	if (settings != nullptr) {
+		// a target bitrate wins, crunch binary searches the quality level
+		// for it, so it costs a few passes over the texture
+		if (settings->targetBitrate > 0.0f && std::isfinite(settings->targetBitrate)) {
+			comp_params.m_target_bitrate = settings->targetBitrate;
+		} else if (settings->qualityLevel >= 0) {
+			comp_params.m_quality_level = (crn_uint32)std::min(settings->qualityLevel, (int)cCRNMaxQualityLevel);
+		}
+	}
 
 	comp_params.m_userdata0 = ver; //custom version field??? idek
-	comp_params.m_num_helper_threads = 1; //staying safe for xplat for now
+	comp_params.m_num_helper_threads = GetCrunchHelperThreadCount(helperThreads);
+
+	ProgressReporter reporter(progress, progressData, 1);
+	CrunchProgressState progressState;
+	progressState.job = GetCurrentJob();
+	progressState.reporter = progress != nullptr ? &reporter : nullptr;
+	if (progressState.job != nullptr || progressState.reporter != nullptr) {
+		comp_params.m_pProgress_func = CrunchProgress;
+		comp_params.m_pProgress_func_data = &progressState;
+	}
 
 	crn_mipmap_params mip_params;
 	mip_params.m_gamma_filtering = true;
@@ -300,35 +1785,149 @@ EXPORT unsigned int EncodeByCrunchUnity(void* data, int* checkoutId, int mode, i
 	float actual_bitrate;
 	crn_uint32 output_file_size;
 
+	auto start = std::chrono::steady_clock::now();
 	void* newData = crn_compress(comp_params, mip_params, output_file_size, &actual_quality_level, &actual_bitrate);
+	if (newData == NULL) {
+		return 0;
+	}
 
-	if (checkoutId != NULL) {
-		void* outBuf = malloc(output_file_size);
-		if (outBuf == NULL) {
-			return 0;
-		}
+	if (settings != nullptr) {
+		settings->actualQualityLevel = actual_quality_level;
+		settings->actualBitrate = actual_bitrate;
+		settings->encodeTimeMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
 
-		memcpy(outBuf, newData, output_file_size);
-		
-		// todo: not thread safe (although we don't do any threading right now)
-		*checkoutId = nextMemoryPickupId;
-		memoryPickup[nextMemoryPickupId] = outBuf;
-		nextMemoryPickupId++;
+	if (checkoutId == NULL) {
+		crn_free_block(newData);
+		return 0;
+	}
 
-		return output_file_size;
-	} else {
+	// hand out crnlib's own block, the managed side copies it out once
+	// and releasing the handle gives it back to crn_free_block
+	int id = ResultTableStore(newData, output_file_size, crn_free_block);
+	if (id < 0) {
+		crn_free_block(newData);
 		return 0;
 	}
+
+	*checkoutId = id;
+	return output_file_size;
+}
+
+// results from EncodeByCrunchUnity are picked up with these. ask for the size
+// (also returned by the encode), copy it out, then release it exactly once.
+EXPORT unsigned int GetResultSize(int id) {
+	unsigned int size;
+	if (!ResultTableGetSize(id, size)) {
+		return 0;
+	}
+	return size;
+}
+
+EXPORT bool CopyResult(void* outBuf, unsigned int size, int id) {
+	return ResultTableCopy(id, outBuf, size);
+}
+
+EXPORT bool ReleaseResult(int id) {
+	return ResultTableRelease(id);
 }
 
 EXPORT bool PickUpAndFree(void* outBuf, unsigned int size, int id)
 {
-	if (memoryPickup.find(id) != memoryPickup.end()) {
-		void* memory = memoryPickup[id];
-		memcpy(outBuf, memory, size);
-		memoryPickup.erase(id);
-		free(memory);
-		return true;
-	}
-	return false;
-}
\ No newline at end of file
+	if (!ResultTableCopy(id, outBuf, size)) {
+		return false;
+	}
+	return ResultTableRelease(id);
+}
+
+static void FreeJobResult(void* data) {
+	free(data);
+}
+
+// runs after the input has been copied, so the managed side can let go of it
+// right away. the output goes in the result table for PickUpAndFree.
+static int StoreJobOutput(uint8_t* output, unsigned int size) {
+	if (size == 0) {
+		free(output);
+		return -1;
+	}
+
+	int id = ResultTableStore(output, size, FreeJobResult);
+	if (id < 0) {
+		free(output);
+	}
+	return id;
+}
+
+// EncodeWithMips (or EncodeByCrunchUnity for the crunched formats) in the
+// background. data is rgba32 and gets copied, so it can go away after this
+// returns. progress is called from the job's thread and has to stay valid
+// until the job is finished. returns the job id.
+EXPORT int SubmitEncode(void* data, int mode, int level, unsigned int width, unsigned int height, unsigned int ver, int mips, bool flipY,
+	EncodeProgressFunc progress, void* progressData) {
+	const uint8_t* src = (const uint8_t*)data;
+	std::shared_ptr<std::vector<uint8_t>> input = std::make_shared<std::vector<uint8_t>>(src, src + (size_t)width * height * 4);
+
+	return JobSubmit([=]() {
+		if (mode == 28 || mode == 29 || mode == 64 || mode == 65) {
+			int checkoutId = -1;
+			if (EncodeByCrunchUnity(input->data(), &checkoutId, mode, level, width, height, ver, mips, flipY, -1, nullptr, progress, progressData) == 0) {
+				return -1;
+			}
+			return checkoutId;
+		}
+
+		size_t outSize = 0;
+		for (int i = 0; i < std::max(1, mips); i++) {
+			outSize += GetTextureByteSize(mode, std::max(1U, width >> i), std::max(1U, height >> i));
+		}
+		if (outSize > UINT_MAX) {
+			return -1;
+		}
+
+		uint8_t* output = (uint8_t*)malloc(outSize);
+		if (output == nullptr) {
+			return -1;
+		}
+		unsigned int size = EncodeWithMips(input->data(), output, (unsigned int)outSize, mode, level, width, height, mips, flipY, progress, progressData);
+		return StoreJobOutput(output, size);
+	});
+}
+
+// DecodeCached in the background, the result is width * height * 4 bytes of
+// rgba32. data gets copied. returns the job id.
+EXPORT int SubmitDecode(void* data, unsigned int dataSize, int mode, unsigned int width, unsigned int height, bool flipY) {
+	const uint8_t* src = (const uint8_t*)data;
+	std::shared_ptr<std::vector<uint8_t>> input = std::make_shared<std::vector<uint8_t>>(src, src + dataSize);
+
+	return JobSubmit([=]() {
+		uint8_t* output = (uint8_t*)malloc((size_t)width * height * 4);
+		if (output == nullptr) {
+			return -1;
+		}
+		unsigned int size = DecodeToRGBACached(input->data(), (unsigned int)input->size(), output, mode, width, height, flipY);
+		return StoreJobOutput(output, size);
+	});
+}
+
+// one of the JobStatus values
+EXPORT int PollJob(int id) {
+	return JobPoll(id);
+}
+
+// waits up to timeoutMs (< 0 for as long as it takes) and returns the status
+EXPORT int WaitJob(int id, int timeoutMs) {
+	return JobWait(id, timeoutMs);
+}
+
+// ispc encodes stop at the next strip, mip chains at the next level and
+// crunch at its next progress check. pvrtexlib finishes the level it's on.
+EXPORT bool CancelJob(int id) {
+	return JobCancel(id);
+}
+
+// always call this once per job. returns the result id to use with
+// GetResultSize and PickUpAndFree if the job finished, -1 otherwise.
+EXPORT int ReleaseJob(int id) {
+	return JobRelease(id);
+}
@@ -0,0 +1,167 @@
+#include "threadpool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+	ThreadPool() : stopping(false) {
+		Start(0);
+	}
+
+	void SetThreadCount(int count) {
+		std::lock_guard<std::mutex> configLock(configMutex);
+		Stop();
+		Start(count);
+	}
+
+	int GetThreadCount() {
+		std::lock_guard<std::mutex> configLock(configMutex);
+		return (int)workers.size() + 1;
+	}
+
+	void Enqueue(std::function<void()> task) {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			queue.push_back(std::move(task));
+		}
+		queueCv.notify_one();
+	}
+
+	int GetWorkerCount() {
+		std::lock_guard<std::mutex> lock(queueMutex);
+		return workerCount;
+	}
+
+private:
+	void Start(int count) {
+		if (count <= 0) {
+			count = (int)std::thread::hardware_concurrency();
+			if (count <= 0) {
+				count = 1;
+			}
+		}
+
+		stopping = false;
+		for (int i = 0; i < count - 1; i++) {
+			workers.emplace_back(&ThreadPool::WorkerMain, this);
+		}
+
+		std::lock_guard<std::mutex> lock(queueMutex);
+		workerCount = (int)workers.size();
+	}
+
+	void Stop() {
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopping = true;
+			workerCount = 0;
+		}
+		queueCv.notify_all();
+
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+	}
+
+	void WorkerMain() {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(queueMutex);
+				queueCv.wait(lock, [this] { return stopping || !queue.empty(); });
+				// finish off whatever was queued before stopping
+				if (queue.empty()) {
+					return;
+				}
+				task = std::move(queue.front());
+				queue.pop_front();
+			}
+			task();
+		}
+	}
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> queue;
+	std::mutex queueMutex;
+	std::condition_variable queueCv;
+	std::mutex configMutex;
+	bool stopping;
+	int workerCount;
+};
+
+// never destroyed on purpose. joining threads from a static destructor
+// while the library is being unloaded deadlocks on windows.
+static ThreadPool& GetPool() {
+	static ThreadPool* pool = new ThreadPool();
+	return *pool;
+}
+
+void SetPoolThreadCount(int count) {
+	GetPool().SetThreadCount(count);
+}
+
+int GetPoolThreadCount() {
+	return GetPool().GetThreadCount();
+}
+
+struct ParallelForState {
+	const std::function<void(int)>* func;
+	int count;
+	std::atomic<int> next;
+	std::atomic<int> done;
+	std::mutex mutex;
+	std::condition_variable cv;
+};
+
+static void RunParallelForItems(ParallelForState* state) {
+	int i;
+	while ((i = state->next.fetch_add(1)) < state->count) {
+		(*state->func)(i);
+		if (state->done.fetch_add(1) + 1 == state->count) {
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->cv.notify_all();
+		}
+	}
+}
+
+void ParallelFor(int count, const std::function<void(int)>& func) {
+	if (count <= 0) {
+		return;
+	}
+
+	ThreadPool& pool = GetPool();
+	int helperCount = pool.GetWorkerCount();
+	if (helperCount > count - 1) {
+		helperCount = count - 1;
+	}
+
+	if (helperCount <= 0) {
+		for (int i = 0; i < count; i++) {
+			func(i);
+		}
+		return;
+	}
+
+	// helpers can start after everything is already done,
+	// so they keep the state alive themselves
+	std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+	state->func = &func;
+	state->count = count;
+	state->next = 0;
+	state->done = 0;
+
+	for (int i = 0; i < helperCount; i++) {
+		pool.Enqueue([state] { RunParallelForItems(state.get()); });
+	}
+
+	RunParallelForItems(state.get());
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->cv.wait(lock, [&state] { return state->done.load() == state->count; });
+}
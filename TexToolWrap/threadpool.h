@@ -0,0 +1,12 @@
+#pragma once
+#include <functional>
+
+// count <= 0 picks the hardware thread count.
+// the calling thread counts as one of the threads.
+void SetPoolThreadCount(int count);
+int GetPoolThreadCount();
+
+// runs func(0) ... func(count - 1) across the pool and waits for all of them.
+// the caller works on items too, so calling this from inside another
+// ParallelFor (or with no workers at all) can't deadlock.
+void ParallelFor(int count, const std::function<void(int)>& func);
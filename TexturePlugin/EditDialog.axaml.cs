@@ -9,6 +9,8 @@ using SixLabors.ImageSharp.PixelFormats;
 using System;
 using System.Collections.Generic;
 using System.Globalization;
+using System.Threading;
+using System.Threading.Tasks;
 using UABEAvalonia;
 using Image = SixLabors.ImageSharp.Image;
 
@@ -21,6 +23,8 @@ namespace TexturePlugin
         private AssetsFileInstance fileInst;
 
         private string imagePath;
+        // set while the save is encoding, cancel stops the encode instead of closing
+        private CancellationTokenSource encodeCts;
 
         public EditDialog()
         {
@@ -32,12 +36,15 @@ namespace TexturePlugin
             btnLoad.Click += BtnLoad_Click;
             btnSave.Click += BtnSave_Click;
             btnCancel.Click += BtnCancel_Click;
+            Closing += EditDialog_Closing;
 
             ddTextureFmt.ItemsSource = Enum.GetValues(typeof(TextureFormat));
             ddFilterMode.ItemsSource = Enum.GetValues(typeof(FilterMode));
             ddWrapModeU.ItemsSource = Enum.GetValues(typeof(WrapMode));
             ddWrapModeV.ItemsSource = Enum.GetValues(typeof(WrapMode));
             ddColorSpace.ItemsSource = Enum.GetValues(typeof(ColorSpace));
+            ddEncodeQuality.ItemsSource = Enum.GetValues(typeof(EncodeQuality));
+            ddEncodeQuality.SelectedIndex = (int)EncodeQuality.Normal;
         }
 
         public EditDialog(string name, TextureFile tex, AssetTypeValueField baseField, AssetsFileInstance fileInst) : this()
@@ -126,18 +133,43 @@ namespace TexturePlugin
                 }
             }
 
+            EncodeQuality quality = (EncodeQuality)ddEncodeQuality.SelectedIndex;
+
             int width = 0, height = 0;
             byte[] encImageBytes = null;
             string exceptionMessage = string.Empty;
+            encodeCts = new CancellationTokenSource();
+            btnSave.IsEnabled = false;
             try
             {
-                encImageBytes = TextureImportExport.Import(imgToImport, fmt, out width, out height, ref mips, platform, platformBlob);
+                if (TextureImportExport.CanImportInBatch(fmt, platform, platformBlob))
+                {
+                    width = imgToImport.Width;
+                    height = imgToImport.Height;
+                    mips = TextureImportExport.ClampMipCount(width, height, mips);
+                    encImageBytes = await EncodeOnJob(imgToImport, fmt, mips, quality, encodeCts.Token);
+                }
+                else
+                {
+                    encImageBytes = TextureImportExport.Import(imgToImport, fmt, out width, out height, ref mips, platform, platformBlob, quality);
+                }
             }
             catch (Exception ex)
             {
                 exceptionMessage = ex.ToString();
             }
 
+            bool cancelled = encodeCts.IsCancellationRequested;
+            encodeCts.Dispose();
+            encodeCts = null;
+            btnSave.IsEnabled = true;
+
+            if (cancelled)
+            {
+                Close(false);
+                return;
+            }
+
             if (encImageBytes == null)
             {
                 string dialogText = $"Failed to encode texture format {fmt}!";
@@ -214,9 +246,36 @@ namespace TexturePlugin
 
         private void BtnCancel_Click(object sender, Avalonia.Interactivity.RoutedEventArgs e)
         {
+            // the save closes the window itself once the encode stops
+            if (encodeCts != null)
+            {
+                encodeCts.Cancel();
+                return;
+            }
+
             Close(false);
         }
 
+        private void EditDialog_Closing(object sender, System.ComponentModel.CancelEventArgs e)
+        {
+            encodeCts?.Cancel();
+        }
+
+        // same as TextureImportExport.Import for plain textures, but the encode runs
+        // on a native job so the window stays responsive and can be cancelled
+        private static async Task<byte[]> EncodeOnJob(Image<Rgba32> image, TextureFormat fmt, int mips, EncodeQuality quality, CancellationToken cancellationToken)
+        {
+            byte[] rgbaData = new byte[image.Width * image.Height * 4];
+            image.CopyPixelDataTo(rgbaData);
+
+            // unity wants the bottom row first, the encoder reads it that way for us
+            using TextureJob job = TextureJob.SubmitEncode(rgbaData, image.Width, image.Height, fmt, (int)quality, mips, true);
+            if (job == null)
+                return null;
+
+            return await job.GetResultAsync(cancellationToken);
+        }
+
         // lazy and quick enum conversion
         private int TextureFormatToIndex(int format)
         {
@@ -0,0 +1,34 @@
+using Avalonia;
+using Avalonia.Controls;
+using System;
+
+namespace TexturePlugin
+{
+    // picks one of the EncodeQuality levels, closes with null on cancel
+    public partial class EncodeQualityDialog : Window
+    {
+        public EncodeQualityDialog()
+        {
+            InitializeComponent();
+#if DEBUG
+            this.AttachDevTools();
+#endif
+            //generated events
+            btnOk.Click += BtnOk_Click;
+            btnCancel.Click += BtnCancel_Click;
+
+            ddEncodeQuality.ItemsSource = Enum.GetValues(typeof(EncodeQuality));
+            ddEncodeQuality.SelectedIndex = (int)EncodeQuality.Normal;
+        }
+
+        private void BtnOk_Click(object sender, Avalonia.Interactivity.RoutedEventArgs e)
+        {
+            Close((EncodeQuality?)ddEncodeQuality.SelectedIndex);
+        }
+
+        private void BtnCancel_Click(object sender, Avalonia.Interactivity.RoutedEventArgs e)
+        {
+            Close(null);
+        }
+    }
+}
@@ -89,9 +89,8 @@ namespace TexturePlugin
                     continue;
                 }
 
-                byte[] data = TextureHelper.GetRawTextureBytes(texFile, cont.FileInstance);
-
-                if (data == null)
+                string resSPath = TextureHelper.GetResSFilePath(texFile, cont.FileInstance);
+                if (resSPath != null && !File.Exists(resSPath))
                 {
                     string resSName = Path.GetFileName(texFile.m_StreamData.path);
                     errorBuilder.AppendLine($"[{errorAssetName}]: resS was detected but {resSName} was not found on disk");
@@ -101,7 +100,18 @@ namespace TexturePlugin
                 byte[] platformBlob = TextureHelper.GetPlatformBlob(texBaseField);
                 uint platform = cont.FileInstance.file.Metadata.TargetPlatform;
 
-                bool success = TextureImportExport.Export(data, file, texFile.m_Width, texFile.m_Height, (TextureFormat)texFile.m_TextureFormat, platform, platformBlob);
+                bool success;
+                if (resSPath != null)
+                {
+                    // decode right out of the .resS instead of reading the whole texture in first
+                    success = TextureImportExport.ExportFromFile(
+                        resSPath, texFile.m_StreamData.offset, texFile.m_StreamData.size, file,
+                        texFile.m_Width, texFile.m_Height, (TextureFormat)texFile.m_TextureFormat, platform, platformBlob);
+                }
+                else
+                {
+                    success = TextureImportExport.Export(texFile.pictureData, file, texFile.m_Width, texFile.m_Height, (TextureFormat)texFile.m_TextureFormat, platform, platformBlob);
+                }
                 if (!success)
                 {
                     string texFormat = ((TextureFormat)texFile.m_TextureFormat).ToString();
@@ -162,9 +172,8 @@ namespace TexturePlugin
                 return false;
             }
 
-            byte[] data = TextureHelper.GetRawTextureBytes(texFile, cont.FileInstance);
-
-            if (data == null)
+            string resSPath = TextureHelper.GetResSFilePath(texFile, cont.FileInstance);
+            if (resSPath != null && !File.Exists(resSPath))
             {
                 string resSName = Path.GetFileName(texFile.m_StreamData.path);
                 await MessageBoxUtil.ShowDialog(win, "Error", $"[{errorAssetName}]: resS was detected but {resSName} was not found on disk");
@@ -174,7 +183,18 @@ namespace TexturePlugin
             byte[] platformBlob = TextureHelper.GetPlatformBlob(texBaseField);
             uint platform = cont.FileInstance.file.Metadata.TargetPlatform;
 
-            bool success = TextureImportExport.Export(data, selectedFilePath, texFile.m_Width, texFile.m_Height, (TextureFormat)texFile.m_TextureFormat, platform, platformBlob);
+            bool success;
+            if (resSPath != null)
+            {
+                // decode right out of the .resS instead of reading the whole texture in first
+                success = TextureImportExport.ExportFromFile(
+                    resSPath, texFile.m_StreamData.offset, texFile.m_StreamData.size, selectedFilePath,
+                    texFile.m_Width, texFile.m_Height, (TextureFormat)texFile.m_TextureFormat, platform, platformBlob);
+            }
+            else
+            {
+                success = TextureImportExport.Export(texFile.pictureData, selectedFilePath, texFile.m_Width, texFile.m_Height, (TextureFormat)texFile.m_TextureFormat, platform, platformBlob);
+            }
             if (!success)
             {
                 string texFormat = ((TextureFormat)texFile.m_TextureFormat).ToString();
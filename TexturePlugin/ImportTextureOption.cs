@@ -5,6 +5,7 @@ using Avalonia.Controls;
 using Avalonia.Platform.Storage;
 using SixLabors.ImageSharp;
 using SixLabors.ImageSharp.PixelFormats;
+using System;
 using System.Collections.Generic;
 using System.IO;
 using System.Linq;
@@ -36,74 +37,199 @@ namespace TexturePlugin
             return true;
         }
 
-        private async Task<bool> ImportTextures(Window win, List<ImportBatchInfo> batchInfos)
+        // progress of span textures starting at index as their slice of the whole batch
+        private class BatchProgress : IProgress<float>
         {
-            StringBuilder errorBuilder = new StringBuilder();
+            private readonly IAssetBundleCompressProgress windowProgress;
+            private readonly int index;
+            private readonly int span;
+            private readonly int count;
 
-            foreach (ImportBatchInfo batchInfo in batchInfos)
+            public BatchProgress(IAssetBundleCompressProgress windowProgress, int index, int count, int span = 1)
             {
-                AssetContainer cont = batchInfo.cont;
+                this.windowProgress = windowProgress;
+                this.index = index;
+                this.span = span;
+                this.count = count;
+            }
 
-                string errorAssetName = $"{Path.GetFileName(cont.FileInstance.path)}/{cont.PathId}";
-                string selectedFilePath = batchInfo.importFile;
-                using Image<Rgba32> imgToImport = Image.Load<Rgba32>(selectedFilePath);
+            public void Report(float value)
+            {
+                windowProgress.SetProgress((index + Math.Clamp(value, 0.0f, 1.0f) * span) / count);
+            }
+        }
 
-                if (!cont.HasValueField)
-                    continue;
+        // a texture waiting for the next EncodeBatch call
+        private class PendingImport
+        {
+            public AssetTypeValueField baseField;
+            public string errorAssetName;
+            public TextureEncoderDecoder.BatchEncodeItem item;
+        }
 
-                AssetTypeValueField baseField = cont.BaseValueField;
-                TextureFormat fmt = (TextureFormat)baseField["m_TextureFormat"].AsInt;
+        // about how much rgba32 gets loaded before it's handed to the encoder
+        private const long BatchByteBudget = 256L * 1024 * 1024;
 
-                byte[] platformBlob = TextureHelper.GetPlatformBlob(baseField);
-                uint platform = cont.FileInstance.file.Metadata.TargetPlatform;
+        private async Task<bool> ImportTextures(Window win, List<ImportBatchInfo> batchInfos, EncodeQuality quality)
+        {
+            // encoding happens off the ui thread so the progress window keeps drawing
+            ProgressWindow progressWindow = new ProgressWindow("Encoding textures...");
+            Task<string> encodeTask = Task.Run(() => EncodeTextures(batchInfos, quality, progressWindow.Progress));
+            await progressWindow.ShowDialog(win);
+            string errors = await encodeTask;
 
-                int mips = 1;
-                if (imgToImport.Width == baseField["m_Width"].AsInt && imgToImport.Height == baseField["m_Height"].AsInt)
-                {
-                    mips = baseField["m_MipCount"].AsInt;
-                }
-                else if (TextureHelper.IsPo2(imgToImport.Width) && TextureHelper.IsPo2(imgToImport.Height))
+            if (errors.Length > 0)
+            {
+                string[] firstLines = errors.Split('\n').Take(20).ToArray();
+                string firstLinesStr = string.Join('\n', firstLines);
+                await MessageBoxUtil.ShowDialog(win, "Some errors occurred while exporting", firstLinesStr);
+            }
+
+            return true;
+        }
+
+        private string EncodeTextures(List<ImportBatchInfo> batchInfos, EncodeQuality quality, IAssetBundleCompressProgress windowProgress)
+        {
+            StringBuilder errorBuilder = new StringBuilder();
+            List<PendingImport> pending = new List<PendingImport>();
+            long pendingBytes = 0;
+            int doneCount = 0;
+
+            // textures that just need their pixels encoded go to the native side
+            // together, everything else (crunch, switch, bc6h) is imported one by one
+            void FlushPending()
+            {
+                if (pending.Count == 0)
+                    return;
+
+                BatchProgress progress = new BatchProgress(windowProgress, doneCount, batchInfos.Count, pending.Count);
+                TextureEncoderDecoder.EncodeBatch(pending.Select(p => p.item).ToList(), progress);
+                foreach (PendingImport import in pending)
                 {
-                    mips = TextureHelper.GetMaxMipCount(imgToImport.Width, imgToImport.Height);
+                    TextureEncoderDecoder.BatchEncodeItem item = import.item;
+                    if (item.result == null)
+                    {
+                        errorBuilder.AppendLine($"[{import.errorAssetName}]: Failed to encode texture format {item.format}");
+                        continue;
+                    }
+
+                    SetTextureData(import.baseField, item.format, item.mips, item.width, item.height, item.result);
                 }
 
-                byte[] encImageBytes = TextureImportExport.Import(selectedFilePath, fmt, out int width, out int height, ref mips, platform, platformBlob);
+                doneCount += pending.Count;
+                pending.Clear();
+                pendingBytes = 0;
+            }
 
-                if (encImageBytes == null)
+            try
+            {
+                for (int i = 0; i < batchInfos.Count; i++)
                 {
-                    errorBuilder.AppendLine($"[{errorAssetName}]: Failed to encode texture format {fmt}");
-                    continue;
-                }
+                    ImportBatchInfo batchInfo = batchInfos[i];
+                    AssetContainer cont = batchInfo.cont;
 
-                AssetTypeValueField m_StreamData = baseField["m_StreamData"];
-                m_StreamData["offset"].AsInt = 0;
-                m_StreamData["size"].AsInt = 0;
-                m_StreamData["path"].AsString = "";
+                    string errorAssetName = $"{Path.GetFileName(cont.FileInstance.path)}/{cont.PathId}";
+                    string selectedFilePath = batchInfo.importFile;
+                    using Image<Rgba32> imgToImport = Image.Load<Rgba32>(selectedFilePath);
 
-                if (!baseField["m_MipCount"].IsDummy)
-                    baseField["m_MipCount"].AsInt = mips;
+                    if (!cont.HasValueField)
+                    {
+                        doneCount++;
+                        continue;
+                    }
 
-                baseField["m_TextureFormat"].AsInt = (int)fmt;
-                // todo: size for multi image textures
-                baseField["m_CompleteImageSize"].AsInt = encImageBytes.Length;
+                    AssetTypeValueField baseField = cont.BaseValueField;
+                    TextureFormat fmt = (TextureFormat)baseField["m_TextureFormat"].AsInt;
 
-                baseField["m_Width"].AsInt = width;
-                baseField["m_Height"].AsInt = height;
+                    byte[] platformBlob = TextureHelper.GetPlatformBlob(baseField);
+                    uint platform = cont.FileInstance.file.Metadata.TargetPlatform;
 
-                AssetTypeValueField image_data = baseField["image data"];
-                image_data.Value.ValueType = AssetValueType.ByteArray;
-                image_data.TemplateField.ValueType = AssetValueType.ByteArray;
-                image_data.AsByteArray = encImageBytes;
-            }
+                    int mips = 1;
+                    if (imgToImport.Width == baseField["m_Width"].AsInt && imgToImport.Height == baseField["m_Height"].AsInt)
+                    {
+                        mips = baseField["m_MipCount"].AsInt;
+                    }
+                    else if (TextureHelper.IsPo2(imgToImport.Width) && TextureHelper.IsPo2(imgToImport.Height))
+                    {
+                        mips = TextureHelper.GetMaxMipCount(imgToImport.Width, imgToImport.Height);
+                    }
 
-            if (errorBuilder.Length > 0)
+                    if (TextureImportExport.CanImportInBatch(fmt, platform, platformBlob))
+                    {
+                        int width = imgToImport.Width;
+                        int height = imgToImport.Height;
+                        byte[] rgbaData = new byte[width * height * 4];
+                        imgToImport.CopyPixelDataTo(rgbaData);
+
+                        pending.Add(new PendingImport
+                        {
+                            baseField = baseField,
+                            errorAssetName = errorAssetName,
+                            item = new TextureEncoderDecoder.BatchEncodeItem
+                            {
+                                data = rgbaData,
+                                width = width,
+                                height = height,
+                                format = fmt,
+                                quality = (int)quality,
+                                mips = TextureImportExport.ClampMipCount(width, height, mips),
+                                // unity wants the bottom row first
+                                flipY = true
+                            }
+                        });
+
+                        pendingBytes += rgbaData.Length;
+                        if (pendingBytes >= BatchByteBudget)
+                            FlushPending();
+
+                        continue;
+                    }
+
+                    BatchProgress progress = new BatchProgress(windowProgress, doneCount, batchInfos.Count);
+                    byte[] encImageBytes = TextureImportExport.Import(selectedFilePath, fmt, out int encWidth, out int encHeight, ref mips, platform, platformBlob, quality, progress);
+                    doneCount++;
+
+                    if (encImageBytes == null)
+                    {
+                        errorBuilder.AppendLine($"[{errorAssetName}]: Failed to encode texture format {fmt}");
+                        continue;
+                    }
+
+                    SetTextureData(baseField, fmt, mips, encWidth, encHeight, encImageBytes);
+                }
+
+                FlushPending();
+            }
+            finally
             {
-                string[] firstLines = errorBuilder.ToString().Split('\n').Take(20).ToArray();
-                string firstLinesStr = string.Join('\n', firstLines);
-                await MessageBoxUtil.ShowDialog(win, "Some errors occurred while exporting", firstLinesStr);
+                // reaching 1 closes the window, even if something threw
+                windowProgress.SetProgress(1.0f);
             }
 
-            return true;
+            return errorBuilder.ToString();
+        }
+
+        private static void SetTextureData(AssetTypeValueField baseField, TextureFormat fmt, int mips, int width, int height, byte[] encImageBytes)
+        {
+            AssetTypeValueField m_StreamData = baseField["m_StreamData"];
+            m_StreamData["offset"].AsInt = 0;
+            m_StreamData["size"].AsInt = 0;
+            m_StreamData["path"].AsString = "";
+
+            if (!baseField["m_MipCount"].IsDummy)
+                baseField["m_MipCount"].AsInt = mips;
+
+            baseField["m_TextureFormat"].AsInt = (int)fmt;
+            // todo: size for multi image textures
+            baseField["m_CompleteImageSize"].AsInt = encImageBytes.Length;
+
+            baseField["m_Width"].AsInt = width;
+            baseField["m_Height"].AsInt = height;
+
+            AssetTypeValueField image_data = baseField["image data"];
+            image_data.Value.ValueType = AssetValueType.ByteArray;
+            image_data.TemplateField.ValueType = AssetValueType.ByteArray;
+            image_data.AsByteArray = encImageBytes;
         }
 
         public async Task<bool> ExecutePlugin(Window win, AssetWorkspace workspace, List<AssetContainer> selection)
@@ -133,7 +259,15 @@ namespace TexturePlugin
                 return false;
             }
 
-            bool success = await ImportTextures(win, batchInfos);
+            // same five levels the edit dialog has
+            EncodeQualityDialog qualityDialog = new EncodeQualityDialog();
+            EncodeQuality? quality = await qualityDialog.ShowDialog<EncodeQuality?>(win);
+            if (quality == null)
+            {
+                return false;
+            }
+
+            bool success = await ImportTextures(win, batchInfos, quality.Value);
             if (success)
             {
                 foreach (AssetContainer cont in selection)
@@ -7,24 +7,161 @@ using System.Threading.Tasks;
 
 namespace TexturePlugin
 {
+    [StructLayout(LayoutKind.Sequential)]
+    public struct EncodeBatchItem
+    {
+        public IntPtr data;
+        public uint width;
+        public uint height;
+        public uint stride;
+        public int mode;
+        public int level;
+        public int mips;
+        public int flipY;
+        public IntPtr outBuf;
+        public uint outBufSize;
+        public uint size;
+        public int status;
+    }
+
+    // pick a crunch quality level (0-255) or a target bits per texel, crunch fills in what it hit
+    [StructLayout(LayoutKind.Sequential)]
+    public struct CrunchEncodeSettings
+    {
+        public int qualityLevel;
+        public float targetBitrate;
+        public uint actualQualityLevel;
+        public float actualBitrate;
+        public float encodeTimeMs;
+
+        public static CrunchEncodeSettings FromQualityLevel(int qualityLevel)
+        {
+            return new CrunchEncodeSettings { qualityLevel = qualityLevel, targetBitrate = 0 };
+        }
+
+        public static CrunchEncodeSettings FromTargetBitrate(float bitsPerTexel)
+        {
+            return new CrunchEncodeSettings { qualityLevel = -1, targetBitrate = bitsPerTexel };
+        }
+    }
+
     public class PInvoke
     {
+        // how far an encode got, called from whichever native thread did the work
+        [UnmanagedFunctionPointer(CallingConvention.Cdecl)]
+        public delegate void EncodeProgressFunc(uint done, uint total, IntPtr userData);
+
         [DllImport("textoolwrap")]
         public static extern uint DecodeByCrunchUnity(IntPtr data, IntPtr buf, int mode, uint width, uint height, uint byteSize);
 
         [DllImport("textoolwrap")]
-        public static extern uint DecodeByPVRTexLib(IntPtr data, IntPtr buf, int mode, uint width, uint height);
+        public static extern uint DecodeCrunchToRGBA(IntPtr data, IntPtr buf, uint width, uint height, uint byteSize, [MarshalAs(UnmanagedType.U1)] bool flipY);
 
         [DllImport("textoolwrap")]
-        public static extern uint EncodeByCrunchUnity(IntPtr data, ref int checkoutId, int mode, int level, uint width, uint height, uint ver, int mips);
+        public static extern uint DecodeAllByCrunchUnity(IntPtr data, uint byteSize, IntPtr buf, uint bufSize);
 
         [DllImport("textoolwrap")]
+        public static extern uint DecodeBCn(IntPtr data, IntPtr buf, int mode, int outMode, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern uint ConvertPixels(IntPtr src, IntPtr dst, int srcMode, int dstMode, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern uint SwizzleSwitchBlocks(IntPtr data, uint dataSize, IntPtr buf, uint bufSize, int mode, uint width, uint height, int gobsPerBlock, int mips);
+
+        [DllImport("textoolwrap")]
+        public static extern uint UnswizzleSwitchBlocks(IntPtr data, uint dataSize, IntPtr buf, uint bufSize, int mode, uint width, uint height, int gobsPerBlock, int mips);
+
+        [DllImport("textoolwrap")]
+        public static extern uint DecodeByPVRTexLib(IntPtr data, IntPtr buf, int mode, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern uint EncodeByCrunchUnity(IntPtr data, ref int checkoutId, int mode, int level, uint width, uint height, uint ver, int mips, [MarshalAs(UnmanagedType.U1)] bool flipY, int helperThreads, ref CrunchEncodeSettings settings, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        [return: MarshalAs(UnmanagedType.U1)]
         public static extern bool PickUpAndFree(IntPtr outBuf, uint size, int id);
 
         [DllImport("textoolwrap")]
-        public static extern uint EncodeByPVRTexLib(IntPtr data, IntPtr buf, int mode, int level, uint width, uint height);
+        public static extern uint GetResultSize(int id);
+
+        [DllImport("textoolwrap")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool CopyResult(IntPtr outBuf, uint size, int id);
+
+        [DllImport("textoolwrap")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool ReleaseResult(int id);
+
+        [DllImport("textoolwrap")]
+        public static extern uint EncodeByPVRTexLib(IntPtr data, IntPtr buf, int mode, int level, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        public static extern uint EncodeByISPC(IntPtr data, IntPtr buf, int mode, int level, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        public static extern uint EncodeHalfByISPC(IntPtr data, IntPtr buf, int mode, int level, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        public static extern int EncodeBatch([In, Out] EncodeBatchItem[] items, int count, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        public static extern uint EncodeWithMips(IntPtr data, IntPtr buf, uint bufSize, int mode, int level, uint width, uint height, int mips, [MarshalAs(UnmanagedType.U1)] bool flipY, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        public static extern uint DecodeCached(IntPtr data, uint dataSize, IntPtr buf, int mode, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern void SetDecodeCacheBudget(ulong bytes);
+
+        [DllImport("textoolwrap")]
+        public static extern void ClearDecodeCache();
+
+        [DllImport("textoolwrap")]
+        public static extern void GetDecodeCacheStats(out ulong hits, out ulong misses, out ulong usedBytes, out ulong entryCount);
+
+        [DllImport("textoolwrap")]
+        public static extern uint DecodeFileRegion([MarshalAs(UnmanagedType.LPUTF8Str)] string path, ulong offset, uint size, IntPtr buf, int mode, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern uint DecodePreview(IntPtr data, uint dataSize, IntPtr buf, uint bufSize, int mode, uint width, uint height, int mipCount, uint previewSize, [MarshalAs(UnmanagedType.U1)] bool flipY, out uint previewWidth, out uint previewHeight);
+
+        [DllImport("textoolwrap")]
+        public static extern uint DecodeRegion(IntPtr data, uint dataSize, IntPtr buf, int mode, uint width, uint height, uint x, uint y, uint regionWidth, uint regionHeight, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern int SubmitEncode(IntPtr data, int mode, int level, uint width, uint height, uint ver, int mips, [MarshalAs(UnmanagedType.U1)] bool flipY, EncodeProgressFunc progress, IntPtr progressData);
+
+        [DllImport("textoolwrap")]
+        public static extern int SubmitDecode(IntPtr data, uint dataSize, int mode, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        public static extern int PollJob(int id);
+
+        [DllImport("textoolwrap")]
+        public static extern int WaitJob(int id, int timeoutMs);
+
+        [DllImport("textoolwrap")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool CancelJob(int id);
+
+        [DllImport("textoolwrap")]
+        public static extern int ReleaseJob(int id);
+
+        [DllImport("textoolwrap")]
+        public static extern IntPtr BeginStreamEncode(int mode, int level, uint width, uint height, [MarshalAs(UnmanagedType.U1)] bool flipY);
+
+        [DllImport("textoolwrap")]
+        [return: MarshalAs(UnmanagedType.U1)]
+        public static extern bool StreamEncodeRows(IntPtr encoder, IntPtr rows, uint rowCount, IntPtr buf, uint bufSize);
+
+        [DllImport("textoolwrap")]
+        public static extern uint EndStreamEncode(IntPtr encoder);
+
+        [DllImport("textoolwrap")]
+        public static extern void SetThreadCount(int count);
 
         [DllImport("textoolwrap")]
-        public static extern uint EncodeByISPC(IntPtr data, IntPtr buf, int mode, int level, uint width, uint height);
+        public static extern int GetThreadCount();
     }
 }
@@ -1,11 +1,24 @@
 ﻿using AssetsTools.NET.Texture;
+using SixLabors.ImageSharp;
 using SixLabors.ImageSharp.PixelFormats;
 using SixLabors.ImageSharp.Processing;
 using System;
+using System.Collections.Generic;
 using System.IO;
+using System.Runtime.InteropServices;
 
 namespace TexturePlugin
 {
+    // speed/quality tradeoff for the encoders, normal is what they always used
+    public enum EncodeQuality
+    {
+        Fastest = 0,
+        Fast = 1,
+        Normal = 2,
+        High = 3,
+        Best = 4
+    }
+
     public class TextureEncoderDecoder
     {
         // needs organization
@@ -150,20 +163,26 @@ namespace TexturePlugin
             }
         }
 
-        private static byte[] DecodeAssetRipperTex(byte[] data, int width, int height, TextureFormat format)
+        private static byte[] DecodeAssetRipperTex(byte[] data, int width, int height, TextureFormat format, bool flipY)
         {
-            byte[] dest = TextureFile.DecodeManaged(data, format, width, height);
+            byte[] bgra = TextureFile.DecodeManaged(data, format, width, height);
 
-            for (int i = 0; i < dest.Length; i += 4)
+            // rows can't be flipped in place, so that needs a second buffer
+            byte[] dest = flipY ? new byte[bgra.Length] : bgra;
+            unsafe
             {
-                byte temp = dest[i];
-                dest[i] = dest[i + 2];
-                dest[i + 2] = temp;
+                fixed (byte* bgraPtr = bgra)
+                fixed (byte* destPtr = dest)
+                {
+                    IntPtr bgraIntPtr = (IntPtr)bgraPtr;
+                    IntPtr destIntPtr = (IntPtr)destPtr;
+                    PInvoke.ConvertPixels(bgraIntPtr, destIntPtr, (int)TextureFormat.BGRA32, (int)TextureFormat.RGBA32, (uint)width, (uint)height, flipY);
+                }
             }
             return dest;
         }
 
-        private static byte[] DecodePVRTexLib(byte[] data, int width, int height, TextureFormat format)
+        private static byte[] DecodePVRTexLib(byte[] data, int width, int height, TextureFormat format, bool flipY)
         {
             byte[] dest = new byte[width * height * 4];
             uint size = 0;
@@ -174,7 +193,7 @@ namespace TexturePlugin
                 {
                     IntPtr dataIntPtr = (IntPtr)dataPtr;
                     IntPtr destIntPtr = (IntPtr)destPtr;
-                    size = PInvoke.DecodeByPVRTexLib(dataIntPtr, destIntPtr, (int)format, (uint)width, (uint)height);
+                    size = PInvoke.DecodeByPVRTexLib(dataIntPtr, destIntPtr, (int)format, (uint)width, (uint)height, flipY);
                 }
             }
             if (size > 0)
@@ -191,27 +210,41 @@ namespace TexturePlugin
             }
         }
 
-        private static byte[] DecodeCrunch(byte[] data, int width, int height, TextureFormat format)
+        // uncrunches every mip and face at once, giving back plain dxt/etc data in unity's layout
+        public static byte[] UncrunchAll(byte[] data)
         {
-            byte[] dest = new byte[width * height * 4];
-            uint size = 0;
             unsafe
             {
                 fixed (byte* dataPtr = data)
-                fixed (byte* destPtr = dest)
                 {
                     IntPtr dataIntPtr = (IntPtr)dataPtr;
-                    IntPtr destIntPtr = (IntPtr)destPtr;
-                    size = PInvoke.DecodeByCrunchUnity(dataIntPtr, destIntPtr, (int)format, (uint)width, (uint)height, (uint)data.Length);
+                    uint size = PInvoke.DecodeAllByCrunchUnity(dataIntPtr, (uint)data.Length, IntPtr.Zero, 0);
+                    if (size == 0)
+                        return null;
+
+                    byte[] dest = new byte[size];
+                    fixed (byte* destPtr = dest)
+                    {
+                        IntPtr destIntPtr = (IntPtr)destPtr;
+                        if (PInvoke.DecodeAllByCrunchUnity(dataIntPtr, (uint)data.Length, destIntPtr, size) != size)
+                            return null;
+                    }
+
+                    return dest;
                 }
             }
-            if (size > 0)
-                return dest; //big size is fine for now
-            else
+        }
+
+        // null stays null, so the native side doesn't track anything
+        private static PInvoke.EncodeProgressFunc MakeProgressFunc(IProgress<float> progress)
+        {
+            if (progress == null)
                 return null;
+
+            return (done, total, userData) => progress.Report(total == 0 ? 1.0f : (float)done / total);
         }
 
-        private static byte[] EncodeISPC(byte[] data, int width, int height, TextureFormat format, int quality)
+        private static byte[] EncodeISPC(byte[] data, int width, int height, TextureFormat format, int quality, bool flipY, IProgress<float> progress)
         {
             int expectedSize = RGBAToFormatByteSize(format, width, height);
             byte[] dest = new byte[expectedSize];
@@ -223,7 +256,7 @@ namespace TexturePlugin
                 {
                     IntPtr dataIntPtr = (IntPtr)dataPtr;
                     IntPtr destIntPtr = (IntPtr)destPtr;
-                    size = PInvoke.EncodeByISPC(dataIntPtr, destIntPtr, (int)format, quality, (uint)width, (uint)height);
+                    size = PInvoke.EncodeByISPC(dataIntPtr, destIntPtr, (int)format, quality, (uint)width, (uint)height, flipY, MakeProgressFunc(progress), IntPtr.Zero);
                 }
             }
 
@@ -249,7 +282,7 @@ namespace TexturePlugin
             }
         }
 
-        private static byte[] EncodePVRTexLib(byte[] data, int width, int height, TextureFormat format, int quality)
+        private static byte[] EncodePVRTexLib(byte[] data, int width, int height, TextureFormat format, int quality, bool flipY, IProgress<float> progress)
         {
             int expectedSize = RGBAToFormatByteSize(format, width, height);
             byte[] dest = new byte[expectedSize];
@@ -261,7 +294,7 @@ namespace TexturePlugin
                 {
                     IntPtr dataIntPtr = (IntPtr)dataPtr;
                     IntPtr destIntPtr = (IntPtr)destPtr;
-                    size = PInvoke.EncodeByPVRTexLib(dataIntPtr, destIntPtr, (int)format, quality, (uint)width, (uint)height);
+                    size = PInvoke.EncodeByPVRTexLib(dataIntPtr, destIntPtr, (int)format, quality, (uint)width, (uint)height, flipY, MakeProgressFunc(progress), IntPtr.Zero);
                 }
             }
 
@@ -287,7 +320,43 @@ namespace TexturePlugin
             }
         }
 
-        private static byte[] EncodeCrunch(byte[] data, int width, int height, TextureFormat format, int quality, int mips)
+        private static byte[] EncodeConvert(byte[] data, int width, int height, TextureFormat format, bool flipY)
+        {
+            byte[] dest = new byte[RGBAToFormatByteSize(format, width, height)];
+            uint size = 0;
+            unsafe
+            {
+                fixed (byte* dataPtr = data)
+                fixed (byte* destPtr = dest)
+                {
+                    IntPtr dataIntPtr = (IntPtr)dataPtr;
+                    IntPtr destIntPtr = (IntPtr)destPtr;
+                    size = PInvoke.ConvertPixels(dataIntPtr, destIntPtr, (int)TextureFormat.RGBA32, (int)format, (uint)width, (uint)height, flipY);
+                }
+            }
+            if (size > 0)
+                return dest;
+            else
+                return null;
+        }
+
+        private static byte[] EncodeCrunch(byte[] data, int width, int height, TextureFormat format, int quality, int mips, bool flipY, IProgress<float> progress)
+        {
+            // neither knob set, so quality picks the level like the other encoders
+            CrunchEncodeSettings settings = CrunchEncodeSettings.FromQualityLevel(-1);
+            return EncodeCrunch(data, width, height, format, quality, ref settings, mips, flipY, progress);
+        }
+
+        // crunch with direct control over the size/time tradeoff, settings comes back
+        // with the quality level and bitrate crunch ended up at and how long it took
+        public static byte[] EncodeCrunch(byte[] data, int width, int height, TextureFormat format, ref CrunchEncodeSettings settings,
+            int mips = 1, bool flipY = false, IProgress<float> progress = null)
+        {
+            return EncodeCrunch(data, width, height, format, (int)EncodeQuality.Normal, ref settings, mips, flipY, progress);
+        }
+
+        private static byte[] EncodeCrunch(byte[] data, int width, int height, TextureFormat format, int quality, ref CrunchEncodeSettings settings,
+            int mips, bool flipY, IProgress<float> progress)
         {
             byte[] dest = Array.Empty<byte>();
             uint size = 0;
@@ -297,77 +366,73 @@ namespace TexturePlugin
                 fixed (byte* dataPtr = data)
                 {
                     // we don't know the size of the output yet
-                    // write it to unmanaged memory first and copy to managed after we have the size
+                    // crunch keeps it in unmanaged memory until we copy it out below
                     // ////////////
                     // setting ver to 1 fixes "The texture could not be loaded because it has been
                     // encoded with an older version of Crunch" not sure if this breaks older games though
                     // todo: determine version ranges
                     IntPtr dataIntPtr = (IntPtr)dataPtr;
-                    size = PInvoke.EncodeByCrunchUnity(dataIntPtr, ref checkoutId, (int)format, quality, (uint)width, (uint)height, 1, mips);
+                    size = PInvoke.EncodeByCrunchUnity(dataIntPtr, ref checkoutId, (int)format, quality, (uint)width, (uint)height, 1, mips, flipY, -1, ref settings, MakeProgressFunc(progress), IntPtr.Zero);
                     if (size == 0)
                     {
                         return null;
                     }
                 }
 
-                dest = new byte[size];
-
-                fixed (byte* destPtr = dest)
+                try
                 {
-                    IntPtr destIntPtr = (IntPtr)destPtr;
-                    if (!PInvoke.PickUpAndFree(destIntPtr, size, checkoutId))
+                    dest = new byte[size];
+
+                    fixed (byte* destPtr = dest)
                     {
-                        return null;
+                        IntPtr destIntPtr = (IntPtr)destPtr;
+                        if (!PInvoke.CopyResult(destIntPtr, size, checkoutId))
+                        {
+                            return null;
+                        }
                     }
                 }
+                finally
+                {
+                    PInvoke.ReleaseResult(checkoutId);
+                }
             }
 
-            if (size > 0)
+            return dest;
+        }
+
+        // flipY turns the rows upside down while decoding, unity stores them bottom up
+        // goes through the native decode cache, so looking at the same texture again
+        // is just a copy. null for formats only decoded here on the managed side.
+        private static byte[] DecodeCached(byte[] data, int width, int height, TextureFormat format, bool flipY)
+        {
+            byte[] dest = new byte[width * height * 4];
+            uint size = 0;
+            unsafe
             {
-                byte[] resizedDest = new byte[size];
-                Buffer.BlockCopy(dest, 0, resizedDest, 0, (int)size);
-                dest = null;
-                return resizedDest;
+                fixed (byte* dataPtr = data)
+                fixed (byte* destPtr = dest)
+                {
+                    size = PInvoke.DecodeCached((IntPtr)dataPtr, (uint)data.Length, (IntPtr)destPtr, (int)format, (uint)width, (uint)height, flipY);
+                }
             }
-            else
-            {
-                dest = null;
+
+            if (size != dest.Length)
                 return null;
-            }
+
+            return dest;
         }
 
-        public static byte[] Decode(byte[] data, int width, int height, TextureFormat format)
+        // formats DecodeCached can decode, the rest are only decoded on the managed side
+        // and shouldn't be hashed into the native cache for nothing
+        public static bool CanDecodeNatively(TextureFormat format)
         {
             switch (format)
             {
-                //crunch
                 case TextureFormat.DXT1Crunched:
                 case TextureFormat.DXT5Crunched:
                 case TextureFormat.ETC_RGB4Crunched:
                 case TextureFormat.ETC2_RGBA8Crunched:
-                {
-                    byte[] uncrunch = DecodeCrunch(data, width, height, format);
-                    if (uncrunch == null)
-                        return null;
-
-                    format = format switch
-                    {
-                        TextureFormat.DXT1Crunched => TextureFormat.DXT1,
-                        TextureFormat.DXT5Crunched => TextureFormat.DXT5,
-                        TextureFormat.ETC_RGB4Crunched => TextureFormat.ETC_RGB4,
-                        TextureFormat.ETC2_RGBA8Crunched => TextureFormat.ETC2_RGBA8,
-                        _ => 0 //can't happen
-                    };
-
-                    byte[] res;
-                    if (format == TextureFormat.DXT1 || format == TextureFormat.DXT5)
-                        res = DecodeAssetRipperTex(uncrunch, width, height, format);
-                    else //if (format == TextureFormat.ETC_RGB4 || format == TextureFormat.ETC2_RGBA8)
-                        res = DecodePVRTexLib(uncrunch, width, height, format);
-
-                    return res;
-                }
-                //pvrtexlib
                 case TextureFormat.ARGB32:
                 case TextureFormat.BGRA32:
                 case TextureFormat.RGBA32:
@@ -385,15 +450,11 @@ namespace TexturePlugin
                 case TextureFormat.RFloat:
                 case TextureFormat.RGFloat:
                 case TextureFormat.RGBAFloat:
-                /////////////////////////////////
-                case TextureFormat.YUY2:
                 case TextureFormat.EAC_R:
                 case TextureFormat.EAC_R_SIGNED:
                 case TextureFormat.EAC_RG:
                 case TextureFormat.EAC_RG_SIGNED:
                 case TextureFormat.ETC_RGB4:
-                case TextureFormat.ETC_RGB4_3DS:
-                case TextureFormat.ETC_RGBA8_3DS:
                 case TextureFormat.ETC2_RGB4:
                 case TextureFormat.ETC2_RGBA1:
                 case TextureFormat.ETC2_RGBA8:
@@ -413,21 +474,39 @@ namespace TexturePlugin
                 case TextureFormat.ASTC_RGBA_8x8:
                 case TextureFormat.ASTC_RGBA_10x10:
                 case TextureFormat.ASTC_RGBA_12x12:
-                {
-                    byte[] res = DecodePVRTexLib(data, width, height, format);
-                    return res;
-                }
-                //assetripper.texture
                 case TextureFormat.DXT1:
                 case TextureFormat.DXT5:
                 case TextureFormat.BC7:
                 case TextureFormat.BC6H:
                 case TextureFormat.BC4:
                 case TextureFormat.BC5:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        public static byte[] Decode(byte[] data, int width, int height, TextureFormat format, bool flipY = false)
+        {
+            // the native side already tried everything it has, so no second go below
+            if (CanDecodeNatively(format))
+                return DecodeCached(data, width, height, format, flipY);
+
+            switch (format)
+            {
+                //pvrtexlib
+                case TextureFormat.YUY2:
+                case TextureFormat.ETC_RGB4_3DS:
+                case TextureFormat.ETC_RGBA8_3DS:
+                {
+                    byte[] res = DecodePVRTexLib(data, width, height, format, flipY);
+                    return res;
+                }
+                //assetripper.texture
                 case TextureFormat.RGB9e5Float:
                 case TextureFormat.RGBA64:
                 {
-                    byte[] res = DecodeAssetRipperTex(data, width, height, format);
+                    byte[] res = DecodeAssetRipperTex(data, width, height, format, flipY);
                     return res;
                 }
                 default:
@@ -435,7 +514,93 @@ namespace TexturePlugin
             }
         }
 
-        public static byte[] EncodeMip(byte[] data, int width, int height, TextureFormat format, int quality, int mips = 1)
+        // decodes straight out of a mapped region of the file, so the encoded data
+        // never gets read into a managed array. null if the native side can't
+        // decode the format, read the bytes in and use Decode for those.
+        public static byte[] DecodeFile(string path, ulong offset, uint size, int width, int height, TextureFormat format, bool flipY = false)
+        {
+            byte[] dest = new byte[width * height * 4];
+            uint decSize = 0;
+            unsafe
+            {
+                fixed (byte* destPtr = dest)
+                {
+                    decSize = PInvoke.DecodeFileRegion(path, offset, size, (IntPtr)destPtr, (int)format, (uint)width, (uint)height, flipY);
+                }
+            }
+
+            if (decSize != dest.Length)
+                return null;
+
+            return dest;
+        }
+
+        // decodes a small version for thumbnails, at least previewSize on the longer
+        // side (unless the texture is smaller). it comes from the smallest mip that's
+        // big enough, and bcn only decodes some of the blocks when that's still big.
+        // null if the native side can't decode the format.
+        public static byte[] DecodePreview(byte[] data, int width, int height, TextureFormat format, int mipCount, int previewSize,
+            out int previewWidth, out int previewHeight, bool flipY = false)
+        {
+            previewWidth = 0;
+            previewHeight = 0;
+
+            byte[] dest;
+            uint decSize = 0;
+            unsafe
+            {
+                fixed (byte* dataPtr = data)
+                {
+                    uint needed = PInvoke.DecodePreview((IntPtr)dataPtr, (uint)data.Length, IntPtr.Zero, 0, (int)format,
+                        (uint)width, (uint)height, mipCount, (uint)previewSize, flipY, out uint prevWidth, out uint prevHeight);
+                    if (needed == 0)
+                        return null;
+
+                    dest = new byte[needed];
+                    fixed (byte* destPtr = dest)
+                    {
+                        decSize = PInvoke.DecodePreview((IntPtr)dataPtr, (uint)data.Length, (IntPtr)destPtr, (uint)dest.Length, (int)format,
+                            (uint)width, (uint)height, mipCount, (uint)previewSize, flipY, out prevWidth, out prevHeight);
+                    }
+
+                    previewWidth = (int)prevWidth;
+                    previewHeight = (int)prevHeight;
+                }
+            }
+
+            if (decSize != dest.Length)
+                return null;
+
+            return dest;
+        }
+
+        // decodes just one rectangle of the texture, only touching the blocks under it.
+        // x and y are in the decoded image, so with flipY they count from the top.
+        // null if the native side can't decode the format or the rect is out of bounds.
+        public static byte[] DecodeRegion(byte[] data, int width, int height, TextureFormat format, int x, int y, int regionWidth, int regionHeight, bool flipY = false)
+        {
+            if (x < 0 || y < 0 || regionWidth <= 0 || regionHeight <= 0)
+                return null;
+
+            byte[] dest = new byte[regionWidth * regionHeight * 4];
+            uint decSize = 0;
+            unsafe
+            {
+                fixed (byte* dataPtr = data)
+                fixed (byte* destPtr = dest)
+                {
+                    decSize = PInvoke.DecodeRegion((IntPtr)dataPtr, (uint)data.Length, (IntPtr)destPtr, (int)format, (uint)width, (uint)height,
+                        (uint)x, (uint)y, (uint)regionWidth, (uint)regionHeight, flipY);
+                }
+            }
+
+            if (decSize != dest.Length)
+                return null;
+
+            return dest;
+        }
+
+        public static byte[] EncodeMip(byte[] data, int width, int height, TextureFormat format, int quality, int mips = 1, bool flipY = false, IProgress<float> progress = null)
         {
             switch (format)
             {
@@ -445,18 +610,23 @@ namespace TexturePlugin
                 case TextureFormat.ETC_RGB4Crunched:
                 case TextureFormat.ETC2_RGBA8Crunched:
                 {
-                    byte[] res = EncodeCrunch(data, width, height, format, quality, mips);
+                    byte[] res = EncodeCrunch(data, width, height, format, quality, mips, flipY, progress);
                     return res;
                 }
-                //pvrtexlib
+                //plain channel shuffles
                 case TextureFormat.ARGB32:
                 case TextureFormat.BGRA32:
                 case TextureFormat.RGBA32:
                 case TextureFormat.RGB24:
+                case TextureFormat.Alpha8:
+                {
+                    byte[] res = EncodeConvert(data, width, height, format, flipY);
+                    return res;
+                }
+                //pvrtexlib
                 case TextureFormat.ARGB4444:
                 case TextureFormat.RGBA4444:
                 case TextureFormat.RGB565:
-                case TextureFormat.Alpha8:
                 case TextureFormat.R8:
                 case TextureFormat.R16:
                 case TextureFormat.RG16:
@@ -472,7 +642,6 @@ namespace TexturePlugin
                 case TextureFormat.EAC_R_SIGNED:
                 case TextureFormat.EAC_RG:
                 case TextureFormat.EAC_RG_SIGNED:
-                case TextureFormat.ETC_RGB4:
                 case TextureFormat.ETC_RGB4_3DS:
                 case TextureFormat.ETC_RGBA8_3DS:
                 case TextureFormat.ETC2_RGB4:
@@ -482,33 +651,34 @@ namespace TexturePlugin
                 case TextureFormat.PVRTC_RGBA2:
                 case TextureFormat.PVRTC_RGB4:
                 case TextureFormat.PVRTC_RGBA4:
-                case TextureFormat.ASTC_RGB_4x4:
-                case TextureFormat.ASTC_RGB_5x5:
-                case TextureFormat.ASTC_RGB_6x6:
-                case TextureFormat.ASTC_RGB_8x8:
                 case TextureFormat.ASTC_RGB_10x10:
                 case TextureFormat.ASTC_RGB_12x12:
-                case TextureFormat.ASTC_RGBA_4x4:
-                case TextureFormat.ASTC_RGBA_5x5:
-                case TextureFormat.ASTC_RGBA_6x6:
-                case TextureFormat.ASTC_RGBA_8x8:
                 case TextureFormat.ASTC_RGBA_10x10:
                 case TextureFormat.ASTC_RGBA_12x12:
                 {
-                    byte[] res = EncodePVRTexLib(data, width, height, format, quality);
+                    byte[] res = EncodePVRTexLib(data, width, height, format, quality, flipY, progress);
                     return res;
                 }
+                //ispc
                 case TextureFormat.DXT1:
                 case TextureFormat.DXT5:
+                case TextureFormat.BC4:
+                case TextureFormat.BC5:
+                case TextureFormat.BC6H:
                 case TextureFormat.BC7:
+                case TextureFormat.ETC_RGB4:
+                case TextureFormat.ASTC_RGB_4x4:
+                case TextureFormat.ASTC_RGB_5x5:
+                case TextureFormat.ASTC_RGB_6x6:
+                case TextureFormat.ASTC_RGB_8x8:
+                case TextureFormat.ASTC_RGBA_4x4:
+                case TextureFormat.ASTC_RGBA_5x5:
+                case TextureFormat.ASTC_RGBA_6x6:
+                case TextureFormat.ASTC_RGBA_8x8:
                 {
-                    byte[] res = EncodeISPC(data, width, height, format, quality);
+                    byte[] res = EncodeISPC(data, width, height, format, quality, flipY, progress);
                     return res;
                 }
-                case TextureFormat.BC6H: //pls don't use
-                case TextureFormat.BC4:
-                case TextureFormat.BC5:
-                    return null;
                 case TextureFormat.RGB9e5Float: //pls don't use
                     return null;
                 default:
@@ -516,8 +686,19 @@ namespace TexturePlugin
             }
         }
 
-        public static byte[] Encode(SixLabors.ImageSharp.Image<Rgba32> image, int width, int height, TextureFormat format, int quality = 5, int mips = 1)
+        // progress goes from 0 to 1 and can be reported from any thread
+        public static byte[] Encode(SixLabors.ImageSharp.Image<Rgba32> image, int width, int height, TextureFormat format, int quality = (int)EncodeQuality.Normal, int mips = 1, bool flipY = false,
+            IProgress<float> progress = null)
         {
+            // no mips to build, so rows can go to the encoder a band at a time
+            // instead of copying the whole image out first
+            if (mips <= 1)
+            {
+                byte[] streamedData = EncodeStreamed(image, width, height, format, quality, flipY, progress);
+                if (streamedData != null)
+                    return streamedData;
+            }
+
             using MemoryStream rawDataStream = new MemoryStream();
 
             if (format == TextureFormat.DXT1Crunched || format == TextureFormat.DXT5Crunched ||
@@ -525,34 +706,350 @@ namespace TexturePlugin
             {
                 byte[] rawRgbaData = new byte[width * height * 4];
                 image.CopyPixelDataTo(rawRgbaData);
-                byte[] rawEncodedData = EncodeMip(rawRgbaData, width, height, format, quality, mips);
+                byte[] rawEncodedData = EncodeMip(rawRgbaData, width, height, format, quality, mips, flipY, progress);
                 rawDataStream.Write(rawEncodedData);
             }
             else
             {
+                // mips are generated on the native side from the base level
+                int encSize = 0;
                 int curWidth = width;
                 int curHeight = height;
                 for (int i = 0; i < mips; i++)
                 {
-                    byte[] rawRgbaData = new byte[curWidth * curHeight * 4];
-                    image.CopyPixelDataTo(rawRgbaData);
-                    byte[] rawEncodedData = EncodeMip(rawRgbaData, curWidth, curHeight, format, quality);
-                    if (rawEncodedData == null)
+                    encSize += RGBAToFormatByteSize(format, curWidth, curHeight);
+                    curWidth = Math.Max(1, curWidth >> 1);
+                    curHeight = Math.Max(1, curHeight >> 1);
+                }
+
+                byte[] rawRgbaData = new byte[width * height * 4];
+                image.CopyPixelDataTo(rawRgbaData);
+
+                byte[] rawEncodedData = new byte[encSize];
+                uint size = 0;
+                unsafe
+                {
+                    fixed (byte* rgbaPtr = rawRgbaData)
+                    fixed (byte* encPtr = rawEncodedData)
                     {
-                        return null;
+                        size = PInvoke.EncodeWithMips((IntPtr)rgbaPtr, (IntPtr)encPtr, (uint)encSize, (int)format, quality, (uint)width, (uint)height, mips, flipY, MakeProgressFunc(progress), IntPtr.Zero);
                     }
-                    rawDataStream.Write(rawEncodedData);
+                }
 
-                    if (i < mips - 1)
+                if (size == 0)
+                {
+                    return null;
+                }
+                else if (size == encSize)
+                {
+                    return rawEncodedData;
+                }
+
+                rawDataStream.Write(rawEncodedData, 0, (int)size);
+            }
+
+            return rawDataStream.ToArray();
+        }
+
+        // one texture for EncodeBatch. data is tightly packed rgba32, result gets
+        // the encoded mip chain or stays null if that texture failed.
+        public class BatchEncodeItem
+        {
+            public byte[] data;
+            public int width;
+            public int height;
+            public TextureFormat format;
+            public int quality = (int)EncodeQuality.Normal;
+            public int mips = 1;
+            public bool flipY;
+            public byte[] result;
+        }
+
+        // the formats EncodeMip sends to ispc, pvrtexlib or a plain shuffle, which
+        // is what the native batch encoder picks from too. crunch isn't in here.
+        public static bool CanEncodeInBatch(TextureFormat format)
+        {
+            switch (format)
+            {
+                case TextureFormat.ARGB32:
+                case TextureFormat.BGRA32:
+                case TextureFormat.RGBA32:
+                case TextureFormat.RGB24:
+                case TextureFormat.Alpha8:
+                case TextureFormat.ARGB4444:
+                case TextureFormat.RGBA4444:
+                case TextureFormat.RGB565:
+                case TextureFormat.R8:
+                case TextureFormat.R16:
+                case TextureFormat.RG16:
+                case TextureFormat.RHalf:
+                case TextureFormat.RGHalf:
+                case TextureFormat.RGBAHalf:
+                case TextureFormat.RFloat:
+                case TextureFormat.RGFloat:
+                case TextureFormat.RGBAFloat:
+                case TextureFormat.YUY2:
+                case TextureFormat.EAC_R:
+                case TextureFormat.EAC_R_SIGNED:
+                case TextureFormat.EAC_RG:
+                case TextureFormat.EAC_RG_SIGNED:
+                case TextureFormat.ETC_RGB4_3DS:
+                case TextureFormat.ETC_RGBA8_3DS:
+                case TextureFormat.ETC2_RGB4:
+                case TextureFormat.ETC2_RGBA1:
+                case TextureFormat.ETC2_RGBA8:
+                case TextureFormat.PVRTC_RGB2:
+                case TextureFormat.PVRTC_RGBA2:
+                case TextureFormat.PVRTC_RGB4:
+                case TextureFormat.PVRTC_RGBA4:
+                case TextureFormat.ASTC_RGB_10x10:
+                case TextureFormat.ASTC_RGB_12x12:
+                case TextureFormat.ASTC_RGBA_10x10:
+                case TextureFormat.ASTC_RGBA_12x12:
+                case TextureFormat.DXT1:
+                case TextureFormat.DXT5:
+                case TextureFormat.BC4:
+                case TextureFormat.BC5:
+                case TextureFormat.BC6H:
+                case TextureFormat.BC7:
+                case TextureFormat.ETC_RGB4:
+                case TextureFormat.ASTC_RGB_4x4:
+                case TextureFormat.ASTC_RGB_5x5:
+                case TextureFormat.ASTC_RGB_6x6:
+                case TextureFormat.ASTC_RGB_8x8:
+                case TextureFormat.ASTC_RGBA_4x4:
+                case TextureFormat.ASTC_RGBA_5x5:
+                case TextureFormat.ASTC_RGBA_6x6:
+                case TextureFormat.ASTC_RGBA_8x8:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        // encodes every item in one native call instead of one per texture, the
+        // native side spreads them (and their mips) over its threads. progress
+        // counts finished items. returns how many encoded successfully.
+        public static int EncodeBatch(IList<BatchEncodeItem> items, IProgress<float> progress = null)
+        {
+            PInvoke.EncodeBatchItem[] nativeItems = new PInvoke.EncodeBatchItem[items.Count];
+            GCHandle[] handles = new GCHandle[items.Count * 2];
+            byte[][] outBufs = new byte[items.Count][];
+            int successCount;
+            try
+            {
+                for (int i = 0; i < items.Count; i++)
+                {
+                    BatchEncodeItem item = items[i];
+                    item.result = null;
+
+                    int encSize = 0;
+                    int curWidth = item.width;
+                    int curHeight = item.height;
+                    for (int m = 0; m < Math.Max(1, item.mips); m++)
                     {
-                        curWidth >>= 1;
-                        curHeight >>= 1;
-                        image.Mutate(i => i.Resize(curWidth, curHeight));
+                        encSize += RGBAToFormatByteSize(item.format, curWidth, curHeight);
+                        curWidth = Math.Max(1, curWidth >> 1);
+                        curHeight = Math.Max(1, curHeight >> 1);
                     }
+
+                    outBufs[i] = new byte[encSize];
+                    handles[i * 2] = GCHandle.Alloc(item.data, GCHandleType.Pinned);
+                    handles[i * 2 + 1] = GCHandle.Alloc(outBufs[i], GCHandleType.Pinned);
+
+                    nativeItems[i] = new PInvoke.EncodeBatchItem
+                    {
+                        data = handles[i * 2].AddrOfPinnedObject(),
+                        width = (uint)item.width,
+                        height = (uint)item.height,
+                        stride = 0,
+                        mode = (int)item.format,
+                        level = item.quality,
+                        mips = item.mips,
+                        flipY = item.flipY ? 1 : 0,
+                        outBuf = handles[i * 2 + 1].AddrOfPinnedObject(),
+                        outBufSize = (uint)encSize
+                    };
+                }
+
+                successCount = PInvoke.EncodeBatch(nativeItems, nativeItems.Length, MakeProgressFunc(progress), IntPtr.Zero);
+            }
+            finally
+            {
+                foreach (GCHandle handle in handles)
+                {
+                    if (handle.IsAllocated)
+                        handle.Free();
                 }
             }
 
+            for (int i = 0; i < items.Count; i++)
+            {
+                uint size = nativeItems[i].size;
+                if (nativeItems[i].status != 0 || size == 0)
+                    continue;
+
+                if (size == outBufs[i].Length)
+                {
+                    items[i].result = outBufs[i];
+                }
+                else
+                {
+                    byte[] resizedDest = new byte[size];
+                    Buffer.BlockCopy(outBufs[i], 0, resizedDest, 0, (int)size);
+                    items[i].result = resizedDest;
+                }
+            }
+
+            return successCount;
+        }
+
+        // about how much of the image gets copied out per push
+        private const int StreamBandByteSize = 16 * 1024 * 1024;
+
+        // null if the format can't be streamed (pvrtexlib and crunch need the whole image)
+        private static byte[] EncodeStreamed(SixLabors.ImageSharp.Image<Rgba32> image, int width, int height, TextureFormat format, int quality, bool flipY, IProgress<float> progress)
+        {
+            IntPtr encoder = PInvoke.BeginStreamEncode((int)format, quality, (uint)width, (uint)height, flipY);
+            if (encoder == IntPtr.Zero)
+                return null;
+
+            int encSize = RGBAToFormatByteSize(format, width, height);
+            byte[] encData = new byte[encSize];
+
+            int rowByteSize = width * 4;
+            int bandRows = Math.Clamp(StreamBandByteSize / rowByteSize, 1, height);
+            byte[] band = new byte[bandRows * rowByteSize];
+            bool success = true;
+
+            uint size;
+            try
+            {
+                image.ProcessPixelRows(accessor =>
+                {
+                    for (int y = 0; y < height && success; y += bandRows)
+                    {
+                        int rowCount = Math.Min(bandRows, height - y);
+                        for (int i = 0; i < rowCount; i++)
+                        {
+                            MemoryMarshal.AsBytes(accessor.GetRowSpan(y + i)).CopyTo(band.AsSpan(i * rowByteSize));
+                        }
+
+                        unsafe
+                        {
+                            fixed (byte* bandPtr = band)
+                            fixed (byte* encPtr = encData)
+                            {
+                                success = PInvoke.StreamEncodeRows(encoder, (IntPtr)bandPtr, (uint)rowCount, (IntPtr)encPtr, (uint)encSize);
+                            }
+                        }
+
+                        // each push is a band, that's as fine as it gets here
+                        progress?.Report((float)(y + rowCount) / height);
+                    }
+                });
+            }
+            finally
+            {
+                // frees the encoder, even if a push threw
+                size = PInvoke.EndStreamEncode(encoder);
+            }
+
+            if (!success || size != encSize)
+                return null;
+
+            return encData;
+        }
+
+        // bc6h from a float image so hdr sources don't get squashed into rgba32 first.
+        // mips are made here since the native mip generator only does rgba32.
+        public static byte[] EncodeHalf(Image<RgbaVector> image, int width, int height, TextureFormat format, int quality = (int)EncodeQuality.Normal, int mips = 1, bool flipY = false,
+            IProgress<float> progress = null)
+        {
+            if (format != TextureFormat.BC6H)
+                return null;
+
+            using MemoryStream rawDataStream = new MemoryStream();
+
+            // each level gets a share of the progress by how many pixels it has
+            long totalPixels = 0;
+            for (int i = 0; i < mips; i++)
+            {
+                totalPixels += (long)Math.Max(1, width >> i) * Math.Max(1, height >> i);
+            }
+
+            long pixelsDone = 0;
+            int curWidth = width;
+            int curHeight = height;
+            for (int i = 0; i < mips; i++)
+            {
+                float start = (float)pixelsDone / totalPixels;
+                float share = (float)curWidth * curHeight / totalPixels;
+                PInvoke.EncodeProgressFunc mipProgress = null;
+                if (progress != null)
+                    mipProgress = (done, total, userData) => progress.Report(start + share * (total == 0 ? 1.0f : (float)done / total));
+
+                byte[] mipData;
+                if (i == 0)
+                {
+                    mipData = EncodeHalfMip(image, format, quality, flipY, mipProgress);
+                }
+                else
+                {
+                    using Image<RgbaVector> mipImage = image.Clone(x => x.Resize(curWidth, curHeight, KnownResamplers.Box));
+                    mipData = EncodeHalfMip(mipImage, format, quality, flipY, mipProgress);
+                }
+
+                if (mipData == null)
+                    return null;
+
+                rawDataStream.Write(mipData);
+                pixelsDone += (long)curWidth * curHeight;
+                curWidth = Math.Max(1, curWidth >> 1);
+                curHeight = Math.Max(1, curHeight >> 1);
+            }
+
             return rawDataStream.ToArray();
         }
+
+        private static byte[] EncodeHalfMip(Image<RgbaVector> image, TextureFormat format, int quality, bool flipY, PInvoke.EncodeProgressFunc progress)
+        {
+            int width = image.Width;
+            int height = image.Height;
+
+            ushort[] halfData = new ushort[width * height * 4];
+            image.ProcessPixelRows(accessor =>
+            {
+                int idx = 0;
+                for (int y = 0; y < accessor.Height; y++)
+                {
+                    Span<RgbaVector> row = accessor.GetRowSpan(y);
+                    for (int x = 0; x < row.Length; x++)
+                    {
+                        halfData[idx++] = BitConverter.HalfToUInt16Bits((Half)row[x].R);
+                        halfData[idx++] = BitConverter.HalfToUInt16Bits((Half)row[x].G);
+                        halfData[idx++] = BitConverter.HalfToUInt16Bits((Half)row[x].B);
+                        halfData[idx++] = BitConverter.HalfToUInt16Bits((Half)row[x].A);
+                    }
+                }
+            });
+
+            int expectedSize = RGBAToFormatByteSize(format, width, height);
+            byte[] dest = new byte[expectedSize];
+            uint size = 0;
+            unsafe
+            {
+                fixed (ushort* dataPtr = halfData)
+                fixed (byte* destPtr = dest)
+                {
+                    size = PInvoke.EncodeHalfByISPC((IntPtr)dataPtr, (IntPtr)destPtr, (int)format, quality, (uint)width, (uint)height, flipY, progress, IntPtr.Zero);
+                }
+            }
+
+            if (size != expectedSize)
+                return null;
+
+            return dest;
+        }
     }
 }
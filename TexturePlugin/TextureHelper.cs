@@ -66,26 +66,43 @@ namespace TexturePlugin
             }
         }
 
-        public static byte[] GetRawTextureBytes(TextureFile texFile, AssetsFileInstance inst)
+        // path of the .resS file the texture is streamed from, or null if the data is in the asset.
+        // the file might not exist, check that before using it.
+        public static string GetResSFilePath(TextureFile texFile, AssetsFileInstance inst)
         {
+            if (texFile.m_StreamData.size == 0 || texFile.m_StreamData.path == string.Empty)
+                return null;
+
             string rootPath = Path.GetDirectoryName(inst.path);
-            if (texFile.m_StreamData.size != 0 && texFile.m_StreamData.path != string.Empty)
+            string fixedStreamPath = texFile.m_StreamData.path;
+            if (inst.parentBundle == null && fixedStreamPath.StartsWith("archive:/"))
             {
-                string fixedStreamPath = texFile.m_StreamData.path;
-                if (inst.parentBundle == null && fixedStreamPath.StartsWith("archive:/"))
-                {
-                    fixedStreamPath = Path.GetFileName(fixedStreamPath);
-                }
-                if (!Path.IsPathRooted(fixedStreamPath) && rootPath != null)
-                {
-                    fixedStreamPath = Path.Combine(rootPath, fixedStreamPath);
-                }
-                if (File.Exists(fixedStreamPath))
+                fixedStreamPath = Path.GetFileName(fixedStreamPath);
+            }
+            if (!Path.IsPathRooted(fixedStreamPath) && rootPath != null)
+            {
+                fixedStreamPath = Path.Combine(rootPath, fixedStreamPath);
+            }
+            return fixedStreamPath;
+        }
+
+        public static byte[] ReadResSBytes(string resSPath, ulong offset, uint size)
+        {
+            using Stream stream = File.OpenRead(resSPath);
+            stream.Position = (long)offset;
+            byte[] data = new byte[size];
+            stream.Read(data, 0, (int)size);
+            return data;
+        }
+
+        public static byte[] GetRawTextureBytes(TextureFile texFile, AssetsFileInstance inst)
+        {
+            string resSPath = GetResSFilePath(texFile, inst);
+            if (resSPath != null)
+            {
+                if (File.Exists(resSPath))
                 {
-                    Stream stream = File.OpenRead(fixedStreamPath);
-                    stream.Position = (long)texFile.m_StreamData.offset;
-                    texFile.pictureData = new byte[texFile.m_StreamData.size];
-                    stream.Read(texFile.pictureData, 0, (int)texFile.m_StreamData.size);
+                    texFile.pictureData = ReadResSBytes(resSPath, texFile.m_StreamData.offset, texFile.m_StreamData.size);
                 }
                 else
                 {
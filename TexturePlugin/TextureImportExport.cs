@@ -3,76 +3,109 @@ using SixLabors.ImageSharp;
 using SixLabors.ImageSharp.Formats.Tga;
 using SixLabors.ImageSharp.PixelFormats;
 using SixLabors.ImageSharp.Processing;
+using System;
 using System.IO;
 
 namespace TexturePlugin
 {
     public class TextureImportExport
     {
+        // progress goes from 0 to 1 over the encode and can be reported from any thread
         public static byte[] Import(
             string imagePath, TextureFormat format,
             out int width, out int height, ref int mips,
-            uint platform = 0, byte[] platformBlob = null)
+            uint platform = 0, byte[] platformBlob = null,
+            EncodeQuality quality = EncodeQuality.Normal,
+            IProgress<float> progress = null)
         {
+            // bc6h is hdr, so keep whatever precision the source has instead of going through rgba32
+            if (format == TextureFormat.BC6H && !IsSwitchPlatform(platform, platformBlob))
+            {
+                using Image<RgbaVector> hdrImage = Image.Load<RgbaVector>(imagePath);
+                return ImportHdr(hdrImage, format, out width, out height, ref mips, quality, progress);
+            }
+
             using Image<Rgba32> image = Image.Load<Rgba32>(imagePath);
-            return Import(image, format, out width, out height, ref mips, platform, platformBlob);
+            return Import(image, format, out width, out height, ref mips, platform, platformBlob, quality, progress);
+        }
+
+        public static byte[] ImportHdr(
+            Image<RgbaVector> image, TextureFormat format,
+            out int width, out int height, ref int mips,
+            EncodeQuality quality = EncodeQuality.Normal,
+            IProgress<float> progress = null)
+        {
+            width = image.Width;
+            height = image.Height;
+
+            mips = ClampMipCount(width, height, mips);
+
+            byte[] encData = TextureEncoderDecoder.EncodeHalf(image, width, height, format, (int)quality, mips, true, progress);
+            return encData;
         }
 
         public static byte[] Import(
             Image<Rgba32> image, TextureFormat format,
             out int width, out int height, ref int mips,
-            uint platform = 0, byte[] platformBlob = null)
+            uint platform = 0, byte[] platformBlob = null,
+            EncodeQuality quality = EncodeQuality.Normal,
+            IProgress<float> progress = null)
         {
-            // switch swizzle code does not support mipmaps yet (they're a bit special)
-            if (platform == 38 && platformBlob != null && platformBlob.Length != 0)
+            width = image.Width;
+            height = image.Height;
+
+            mips = ClampMipCount(width, height, mips);
+
+            if (IsSwitchPlatform(platform, platformBlob))
             {
-                return ImportSwitch(image, format, out width, out height, platformBlob);
+                return ImportSwitch(image, format, width, height, mips, quality, platformBlob, progress);
             }
 
-            width = image.Width;
-            height = image.Height;
+            // unity wants the bottom row first, the encoder reads it that way for us
+            byte[] encData = TextureEncoderDecoder.Encode(image, width, height, format, (int)quality, mips, true, progress);
+            return encData;
+        }
 
-            // can't make mipmaps from this image
+        // can't make mipmaps from an image that isn't a po2 square
+        public static int ClampMipCount(int width, int height, int mips)
+        {
             if (mips > 1 && (width != height || !TextureHelper.IsPo2(width)))
             {
-                mips = 1;
+                return 1;
             }
+            return mips;
+        }
 
-            image.Mutate(i => i.Flip(FlipMode.Vertical));
+        // whether Import would just encode the rgba32 pixels with their mips, in
+        // which case the caller can hand a whole batch to EncodeBatch instead.
+        // switch textures get swizzled after and bc6h is encoded from floats.
+        public static bool CanImportInBatch(TextureFormat format, uint platform = 0, byte[] platformBlob = null)
+        {
+            return !IsSwitchPlatform(platform, platformBlob)
+                && format != TextureFormat.BC6H
+                && TextureEncoderDecoder.CanEncodeInBatch(format);
+        }
 
-            byte[] encData = TextureEncoderDecoder.Encode(image, width, height, format, 5, mips);
-            return encData;
+        private static bool IsSwitchPlatform(uint platform, byte[] platformBlob)
+        {
+            return platform == 38 && platformBlob != null && platformBlob.Length != 0;
         }
 
         private static byte[] ImportSwitch(
             Image<Rgba32> image, TextureFormat format,
-            out int width, out int height,
-            byte[] platformBlob = null)
+            int width, int height, int mips,
+            EncodeQuality quality, byte[] platformBlob = null,
+            IProgress<float> progress = null)
         {
-            byte[] decData;
-            int paddedWidth, paddedHeight;
-
-            width = image.Width;
-            height = image.Height;
-
             format = GetCorrectedSwitchTextureFormat(format);
             int gobsPerBlock = Texture2DSwitchDeswizzler.GetSwitchGobsPerBlock(platformBlob);
-            Size blockSize = Texture2DSwitchDeswizzler.TextureFormatToBlockSize(format);
-            Size newSize = Texture2DSwitchDeswizzler.GetPaddedTextureSize(width, height, blockSize.Width, blockSize.Height, gobsPerBlock);
-            paddedWidth = newSize.Width;
-            paddedHeight = newSize.Height;
-
-            image.Mutate(i => i.Resize(new ResizeOptions()
-            {
-                Mode = ResizeMode.BoxPad,
-                Position = AnchorPositionMode.BottomLeft,
-                PadColor = Color.Fuchsia, // full alpha?
-                Size = newSize
-            }).Flip(FlipMode.Vertical));
 
-            Image<Rgba32> swizzledImage = Texture2DSwitchDeswizzler.SwitchSwizzle(image, blockSize, gobsPerBlock);
+            // encode the chain like normal, then shuffle the encoded blocks of every level into gobs
+            byte[] linearData = TextureEncoderDecoder.Encode(image, width, height, format, (int)quality, mips, true, progress);
+            if (linearData == null)
+                return null;
 
-            byte[] encData = TextureEncoderDecoder.Encode(swizzledImage, paddedWidth, paddedHeight, format);
+            byte[] encData = Texture2DSwitchDeswizzler.SwitchSwizzle(linearData, width, height, format, gobsPerBlock, mips);
             return encData;
         }
 
@@ -92,51 +125,108 @@ namespace TexturePlugin
             byte[] encData, int width, int height,
             TextureFormat format, uint platform = 0, byte[] platformBlob = null)
         {
-            if (platform == 38 && platformBlob != null && platformBlob.Length != 0)
+            if (IsSwitchPlatform(platform, platformBlob))
             {
                 return ExportSwitch(encData, width, height, format, platformBlob);
             }
 
-            byte[] decData = TextureEncoderDecoder.Decode(encData, width, height, format);
+            byte[] decData = TextureEncoderDecoder.Decode(encData, width, height, format, true);
             if (decData == null)
                 return null;
 
             Image<Rgba32> image = Image.LoadPixelData<Rgba32>(decData, width, height);
-            image.Mutate(i => i.Flip(FlipMode.Vertical));
 
             //SaveImageAtPath(image, file);
 
             return image;
         }
 
+        public static bool ExportFromFile(
+            string resSPath, ulong offset, uint size, string imagePath,
+            int width, int height, TextureFormat format, uint platform = 0, byte[] platformBlob = null)
+        {
+            using Image<Rgba32> image = ExportFromFile(resSPath, offset, size, width, height, format, platform, platformBlob);
+            if (image == null)
+                return false;
+
+            SaveImageAtPath(image, imagePath);
+            return true;
+        }
+
+        public static Image<Rgba32> ExportFromFile(
+            string resSPath, ulong offset, uint size, int width, int height,
+            TextureFormat format, uint platform = 0, byte[] platformBlob = null)
+        {
+            // switch textures have to be unswizzled first, so those still get read in
+            if (!IsSwitchPlatform(platform, platformBlob))
+            {
+                byte[] decData = TextureEncoderDecoder.DecodeFile(resSPath, offset, size, width, height, format, true);
+                if (decData != null)
+                    return Image.LoadPixelData<Rgba32>(decData, width, height);
+            }
+
+            byte[] encData = TextureHelper.ReadResSBytes(resSPath, offset, size);
+            return Export(encData, width, height, format, platform, platformBlob);
+        }
+
+        // a thumbnail around previewSize on its longer side. formats the native side
+        // can't preview (and switch textures) get decoded in full and scaled down.
+        public static Image<Rgba32> ExportPreview(
+            byte[] encData, int width, int height, TextureFormat format,
+            int mipCount, int previewSize, uint platform = 0, byte[] platformBlob = null)
+        {
+            if (!IsSwitchPlatform(platform, platformBlob))
+            {
+                byte[] decData = TextureEncoderDecoder.DecodePreview(encData, width, height, format, mipCount, previewSize, out int previewWidth, out int previewHeight, true);
+                if (decData != null)
+                    return Image.LoadPixelData<Rgba32>(decData, previewWidth, previewHeight);
+            }
+
+            Image<Rgba32> image = Export(encData, width, height, format, platform, platformBlob);
+            if (image != null && Math.Max(width, height) > previewSize && previewSize > 0)
+            {
+                float scale = (float)previewSize / Math.Max(width, height);
+                image.Mutate(i => i.Resize(Math.Max(1, (int)(width * scale)), Math.Max(1, (int)(height * scale))));
+            }
+            return image;
+        }
+
+        // one rectangle of the texture, for zooming in on part of a big one. formats the
+        // native side can't decode (and switch textures) get decoded in full and cropped.
+        public static Image<Rgba32> ExportRegion(
+            byte[] encData, int width, int height, TextureFormat format,
+            int x, int y, int regionWidth, int regionHeight, uint platform = 0, byte[] platformBlob = null)
+        {
+            if (!IsSwitchPlatform(platform, platformBlob))
+            {
+                byte[] decData = TextureEncoderDecoder.DecodeRegion(encData, width, height, format, x, y, regionWidth, regionHeight, true);
+                if (decData != null)
+                    return Image.LoadPixelData<Rgba32>(decData, regionWidth, regionHeight);
+            }
+
+            Image<Rgba32> image = Export(encData, width, height, format, platform, platformBlob);
+            image?.Mutate(i => i.Crop(new Rectangle(x, y, regionWidth, regionHeight)));
+            return image;
+        }
+
         private static Image<Rgba32> ExportSwitch(
             byte[] encData, int width, int height,
             TextureFormat format, byte[] platformBlob = null)
         {
-            int originalWidth = width;
-            int originalHeight = height;
-
             format = GetCorrectedSwitchTextureFormat(format);
             int gobsPerBlock = Texture2DSwitchDeswizzler.GetSwitchGobsPerBlock(platformBlob);
-            Size blockSize = Texture2DSwitchDeswizzler.TextureFormatToBlockSize(format);
-            Size newSize = Texture2DSwitchDeswizzler.GetPaddedTextureSize(width, height, blockSize.Width, blockSize.Height, gobsPerBlock);
-            width = newSize.Width;
-            height = newSize.Height;
 
-            byte[] decData = TextureEncoderDecoder.Decode(encData, width, height, format);
+            // put the blocks back in plain rows first so the normal decoders can read them.
+            // the padding gets dropped on the way, so there's nothing to crop after.
+            byte[] linearData = Texture2DSwitchDeswizzler.SwitchUnswizzle(encData, width, height, format, gobsPerBlock);
+            if (linearData == null)
+                return null;
+
+            byte[] decData = TextureEncoderDecoder.Decode(linearData, width, height, format, true);
             if (decData == null)
                 return null;
 
             Image<Rgba32> image = Image.LoadPixelData<Rgba32>(decData, width, height);
-
-            image = Texture2DSwitchDeswizzler.SwitchUnswizzle(image, blockSize, gobsPerBlock);
-            if (originalWidth != width || originalHeight != height)
-            {
-                image.Mutate(i => i.Crop(originalWidth, originalHeight));
-            }
-
-            image.Mutate(i => i.Flip(FlipMode.Vertical));
-
             return image;
         }
 
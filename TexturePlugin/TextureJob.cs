@@ -0,0 +1,151 @@
+﻿using AssetsTools.NET.Texture;
+using System;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace TexturePlugin
+{
+    // matches JobStatus in jobqueue.h
+    public enum TextureJobStatus
+    {
+        Invalid = -1,
+        Queued = 0,
+        Running = 1,
+        Done = 2,
+        Failed = 3,
+        Cancelled = 4
+    }
+
+    // an encode or decode running in the background on the native side. the
+    // input is copied when it's submitted, so the array can be reused right away.
+    // always dispose it, that's what lets go of the native job.
+    public class TextureJob : IDisposable
+    {
+        private int id;
+        // the native side calls this until the job is done, so it has to outlive the call
+        private PInvoke.EncodeProgressFunc progressFunc;
+
+        private TextureJob(int id)
+        {
+            this.id = id;
+        }
+
+        // progress goes from 0 to 1 and is reported from the job's thread
+        public static TextureJob SubmitEncode(byte[] data, int width, int height, TextureFormat format, int quality, int mips = 1, bool flipY = false,
+            IProgress<float> progress = null)
+        {
+            PInvoke.EncodeProgressFunc progressFunc = null;
+            if (progress != null)
+                progressFunc = (done, total, userData) => progress.Report(total == 0 ? 1.0f : (float)done / total);
+
+            int id;
+            unsafe
+            {
+                fixed (byte* dataPtr = data)
+                {
+                    // ver 1, same as EncodeCrunch
+                    id = PInvoke.SubmitEncode((IntPtr)dataPtr, (int)format, quality, (uint)width, (uint)height, 1, mips, flipY, progressFunc, IntPtr.Zero);
+                }
+            }
+            return id < 0 ? null : new TextureJob(id) { progressFunc = progressFunc };
+        }
+
+        public static TextureJob SubmitDecode(byte[] data, int width, int height, TextureFormat format, bool flipY = false)
+        {
+            int id;
+            unsafe
+            {
+                fixed (byte* dataPtr = data)
+                {
+                    id = PInvoke.SubmitDecode((IntPtr)dataPtr, (uint)data.Length, (int)format, (uint)width, (uint)height, flipY);
+                }
+            }
+            return id < 0 ? null : new TextureJob(id);
+        }
+
+        public TextureJobStatus Status => (TextureJobStatus)PInvoke.PollJob(id);
+
+        // timeoutMs < 0 waits until it's finished
+        public TextureJobStatus Wait(int timeoutMs)
+        {
+            return (TextureJobStatus)PInvoke.WaitJob(id, timeoutMs);
+        }
+
+        public void Cancel()
+        {
+            PInvoke.CancelJob(id);
+        }
+
+        // waits on a pool thread so the ui thread stays free. cancelling the
+        // token cancels the job too, the task then returns null.
+        public Task<byte[]> GetResultAsync(CancellationToken cancellationToken = default)
+        {
+            return Task.Run(() =>
+            {
+                using CancellationTokenRegistration registration = cancellationToken.Register(Cancel);
+                Wait(-1);
+                return TakeResult();
+            });
+        }
+
+        // the output once the job is done, null if it failed or was cancelled.
+        // can only be taken once, the job is released after. also null while the
+        // job is still queued or running, it's left alone then so it can be taken later.
+        public byte[] TakeResult()
+        {
+            if (id < 0)
+                return null;
+
+            TextureJobStatus status = Status;
+            if (status == TextureJobStatus.Queued || status == TextureJobStatus.Running)
+                return null;
+
+            int resultId = PInvoke.ReleaseJob(id);
+            id = -1;
+            if (resultId < 0)
+                return null;
+
+            byte[] dest = new byte[PInvoke.GetResultSize(resultId)];
+            unsafe
+            {
+                fixed (byte* destPtr = dest)
+                {
+                    if (!PInvoke.PickUpAndFree((IntPtr)destPtr, (uint)dest.Length, resultId))
+                        return null;
+                }
+            }
+            return dest;
+        }
+
+        public void Dispose()
+        {
+            Dispose(true);
+            GC.SuppressFinalize(this);
+        }
+
+        // a job that was never disposed still has to stop before progressFunc goes away
+        ~TextureJob()
+        {
+            Dispose(false);
+        }
+
+        protected virtual void Dispose(bool disposing)
+        {
+            if (id >= 0)
+            {
+                // a job that's still running gets cancelled and cleans up after itself,
+                // but one with progress has to stop first or it calls a dead delegate
+                if (progressFunc != null)
+                {
+                    Cancel();
+                    Wait(-1);
+                }
+
+                int resultId = PInvoke.ReleaseJob(id);
+                if (resultId >= 0)
+                    PInvoke.ReleaseResult(resultId);
+                id = -1;
+            }
+        }
+    }
+}